@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 16:18
+* 
+* Description: GraceQ/MPS2 project. Implementation details for the
+* distributed-memory mode.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <map>
+
+#include <assert.h>
+
+#ifdef GQMPS2_USE_MPI
+#include <mpi.h>
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+#ifdef GQMPS2_USE_MPI
+inline MPI_Comm &DistComm(void) {
+  static MPI_Comm comm = MPI_COMM_WORLD;
+  return comm;
+}
+
+
+inline MPI_Datatype DistMpiType(const GQTEN_Double) { return MPI_DOUBLE; }
+
+
+inline MPI_Datatype DistMpiType(const GQTEN_Complex) {
+  return MPI_CXX_DOUBLE_COMPLEX;
+}
+#endif
+
+
+inline int DistRank(void) {
+  int rank = 0;
+#ifdef GQMPS2_USE_MPI
+  int initialized;
+  MPI_Initialized(&initialized);
+  if (initialized) { MPI_Comm_rank(DistComm(), &rank); }
+#endif
+  return rank;
+}
+
+
+inline int DistSize(void) {
+  int size = 1;
+#ifdef GQMPS2_USE_MPI
+  int initialized;
+  MPI_Initialized(&initialized);
+  if (initialized) { MPI_Comm_size(DistComm(), &size); }
+#endif
+  return size;
+}
+
+
+// Owners of the quantum number sectors of an MPO bond. The sectors are dealt
+// out from the largest one to the rank with the least dimension so far, so
+// rank 0 always owns one.
+inline std::vector<int> DistSectorOwners(const Index &idx) {
+  auto size = DistSize();
+  std::vector<std::size_t> order(idx.qnscts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(),
+      [&idx](const std::size_t a, const std::size_t b) {
+        return idx.qnscts[a].dim > idx.qnscts[b].dim;
+      });
+  std::vector<long> loads(size, 0);
+  std::vector<int> owners(idx.qnscts.size());
+  for (auto j : order) {
+    auto owner = std::min_element(loads.begin(), loads.end()) - loads.begin();
+    owners[j] = owner;
+    loads[owner] += idx.qnscts[j].dim;
+  }
+  return owners;
+}
+
+
+// The part of the tensor on the sectors of its leg owned by the rank, with
+// the leg cut down to these sectors, copied block by block. If the rank owns
+// none of them, the leg is kept and the part is empty, so it adds nothing to
+// the sums over the ranks.
+template <typename TenElemType>
+GQTensor<TenElemType> *GenDistSlice(
+    const GQTensor<TenElemType> &ten, const long leg, const int rank) {
+  auto &idx = ten.indexes[leg];
+  auto owners = DistSectorOwners(idx);
+  std::vector<QNSector> qnscts;
+  for (std::size_t j = 0; j < idx.qnscts.size(); ++j) {
+    if (owners[j] == rank) { qnscts.push_back(idx.qnscts[j]); }
+  }
+  if (qnscts.empty()) { return new GQTensor<TenElemType>(ten.indexes); }
+  if (qnscts.size() == idx.qnscts.size()) {
+    return new GQTensor<TenElemType>(ten);
+  }
+
+  auto indexes = ten.indexes;
+  indexes[leg] = Index(qnscts, idx.dir);
+  auto slice = new GQTensor<TenElemType>(indexes);
+  for (auto &ten_blk : ten.cblocks()) {
+    if (owners[SctNum(idx, ten_blk->qnscts[leg])] != rank) { continue; }
+    auto slice_blk = new QNBlock<TenElemType>(ten_blk->qnscts);
+    std::copy(
+        ten_blk->cdata(), ten_blk->cdata() + ten_blk->size,
+        slice_blk->data());
+    slice->blocks().push_back(slice_blk);
+  }
+  return slice;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *GenDistSlice(
+    const GQTensor<TenElemType> &ten, const long leg) {
+  return GenDistSlice(ten, leg, DistRank());
+}
+
+
+// Sector combinations of the blocks of a tensor with the indexes whose
+// quantum number flows agree with div, in the same order on all the ranks.
+inline SctCombos GenDivSctCombos(
+    const std::vector<Index> &idxs, const QN &div) {
+  std::vector<QN> flows;
+  std::vector<SctCombos> combos_grps;
+  GroupSctCombosByFlow(idxs, flows, combos_grps);
+  for (std::size_t g = 0; g < flows.size(); ++g) {
+    if (flows[g] == div) { return combos_grps[g]; }
+  }
+  return SctCombos();
+}
+
+
+// The combinations on which the tensor has a block on any of the ranks, with
+// their offsets packed again, so that the missing blocks are not sent.
+template <typename TenElemType>
+SctCombos DistPresentSctCombos(
+    const GQTensor<TenElemType> &ten, const SctCombos &combos) {
+  std::map<std::vector<std::size_t>, std::size_t> combo_nums;
+  for (std::size_t c = 0; c < combos.scts.size(); ++c) {
+    combo_nums[combos.scts[c]] = c;
+  }
+  std::vector<int> present(combos.scts.size(), 0);
+  for (auto &ten_blk : ten.cblocks()) {
+    std::vector<std::size_t> scts;
+    for (std::size_t i = 0; i < ten.indexes.size(); ++i) {
+      scts.push_back(SctNum(ten.indexes[i], ten_blk->qnscts[i]));
+    }
+    auto combo_num = combo_nums.find(scts);
+    if (combo_num != combo_nums.end()) { present[combo_num->second] = 1; }
+  }
+#ifdef GQMPS2_USE_MPI
+  MPI_Allreduce(
+      MPI_IN_PLACE, present.data(), present.size(), MPI_INT, MPI_MAX,
+      DistComm());
+#endif
+  SctCombos present_combos;
+  for (std::size_t c = 0; c < combos.scts.size(); ++c) {
+    if (!present[c]) { continue; }
+    auto end = (c+1 < combos.scts.size()) ? combos.offsets[c+1] : combos.dim;
+    present_combos.scts.push_back(combos.scts[c]);
+    present_combos.offsets.push_back(present_combos.dim);
+    present_combos.dim += end - combos.offsets[c];
+  }
+  return present_combos;
+}
+
+
+// Copy the blocks of the tensor on the combinations to their offsets in buf,
+// which is zero for the missing blocks.
+template <typename TenElemType>
+void PackDistBlocks(
+    const GQTensor<TenElemType> &ten, const SctCombos &combos,
+    TenElemType *buf) {
+  std::map<std::vector<std::size_t>, long> offsets;
+  for (std::size_t c = 0; c < combos.scts.size(); ++c) {
+    offsets[combos.scts[c]] = combos.offsets[c];
+  }
+  for (auto &ten_blk : ten.cblocks()) {
+    std::vector<std::size_t> scts;
+    for (std::size_t i = 0; i < ten.indexes.size(); ++i) {
+      scts.push_back(SctNum(ten.indexes[i], ten_blk->qnscts[i]));
+    }
+    auto offset = offsets.find(scts);
+    if (offset == offsets.end()) { continue; }
+    std::copy(
+        ten_blk->cdata(), ten_blk->cdata() + ten_blk->size,
+        buf + offset->second);
+  }
+}
+
+
+// Put the nonzero blocks of buf, packed on the combinations of the sectors of
+// idxs, into the tensor.
+template <typename TenElemType>
+void PutDistBlocks(
+    GQTensor<TenElemType> *ten, const std::vector<Index> &idxs,
+    const SctCombos &combos, const TenElemType *buf) {
+  for (std::size_t c = 0; c < combos.scts.size(); ++c) {
+    std::vector<QNSector> qnscts;
+    for (std::size_t i = 0; i < idxs.size(); ++i) {
+      qnscts.push_back(idxs[i].qnscts[combos.scts[c][i]]);
+    }
+    auto ten_blk = new QNBlock<TenElemType>(qnscts);
+    auto blk_buf = buf + combos.offsets[c];
+    if (std::none_of(
+            blk_buf, blk_buf + ten_blk->size,
+            [](const TenElemType elem) { return elem != 0.0; })) {
+      delete ten_blk;
+      continue;
+    }
+    std::copy(blk_buf, blk_buf + ten_blk->size, ten_blk->data());
+    ten->blocks().push_back(ten_blk);
+  }
+}
+
+
+#ifdef GQMPS2_USE_MPI
+// Sum buf over the ranks to the rank root, or to all the ranks if root is
+// negative, in messages of at most kDistMsgMaxElemNum elements.
+template <typename TenElemType>
+void DistReduceSumBuf(std::vector<TenElemType> &buf, const int root) {
+  auto type = DistMpiType(TenElemType());
+  for (std::size_t beg = 0; beg < buf.size(); beg += kDistMsgMaxElemNum) {
+    auto num = std::min(kDistMsgMaxElemNum, buf.size() - beg);
+    if (root < 0) {
+      MPI_Allreduce(
+          MPI_IN_PLACE, buf.data() + beg, num, type, MPI_SUM, DistComm());
+    } else if (DistRank() == root) {
+      MPI_Reduce(
+          MPI_IN_PLACE, buf.data() + beg, num, type, MPI_SUM, root,
+          DistComm());
+    } else {
+      MPI_Reduce(
+          buf.data() + beg, nullptr, num, type, MPI_SUM, root, DistComm());
+    }
+  }
+}
+#endif
+
+
+// Sum of the tensor, which has the same indexes on all the ranks, over the
+// ranks, to the rank root or to all the ranks if root is negative. The other
+// ranks get an empty tensor. Only the blocks which some rank has are packed,
+// in the order of their sector combinations.
+template <typename TenElemType>
+GQTensor<TenElemType> *DistReduceSum(
+    const GQTensor<TenElemType> &ten, const QN &div, const int root) {
+  if (DistSize() == 1) { return new GQTensor<TenElemType>(ten); }
+  auto combos = DistPresentSctCombos(
+                    ten, GenDivSctCombos(ten.indexes, div));
+  std::vector<TenElemType> buf(combos.dim, 0.0);
+  PackDistBlocks(ten, combos, buf.data());
+#ifdef GQMPS2_USE_MPI
+  DistReduceSumBuf(buf, root);
+#endif
+  auto sum = new GQTensor<TenElemType>(ten.indexes);
+  if (root < 0 || DistRank() == root) {
+    PutDistBlocks(sum, ten.indexes, combos, buf.data());
+  }
+  return sum;
+}
+
+
+template <typename TenElemType>
+void DistAllReduceSum(GQTensor<TenElemType> * &ten, const QN &div) {
+  if (DistSize() == 1) { return; }
+  auto sum = DistReduceSum(*ten, div, -1);
+  delete ten;
+  ten = sum;
+}
+
+
+// The slice of GenDistSlice of the sum of the tensor over the ranks. The
+// blocks on the sectors of the leg owned by a rank are only summed to that
+// rank, one owner after another.
+template <typename TenElemType>
+GQTensor<TenElemType> *DistReduceSlice(
+    const GQTensor<TenElemType> &ten, const long leg, const QN &div) {
+  auto rank = DistRank();
+  GQTensor<TenElemType> *slice = nullptr;
+  for (int owner = 0; owner < DistSize(); ++owner) {
+    auto part = GenDistSlice(ten, leg, owner);
+    auto sum = DistReduceSum(*part, div, owner);
+    delete part;
+    if (owner == rank) {
+      slice = sum;
+    } else {
+      delete sum;
+    }
+  }
+  return slice;
+}
+
+
+// The slice of DistReduceSlice of the sum over the ranks of the contraction
+// of ten with mpo_ten on the sectors of the leg of mpo_ten, which becomes the
+// last leg of the product. The product is formed and reduced owner by owner,
+// so a rank never holds it on the sectors of all the owners at once.
+template <typename TenElemType>
+GQTensor<TenElemType> *DistCtrctReduceSlice(
+    const GQTensor<TenElemType> &ten, const GQTensor<TenElemType> &mpo_ten,
+    const long leg, const std::vector<std::vector<long>> &ctrct_axes,
+    const QN &div) {
+  auto rank = DistRank();
+  GQTensor<TenElemType> *slice = nullptr;
+  for (int owner = 0; owner < DistSize(); ++owner) {
+    auto mpo_part = GenDistSlice(mpo_ten, leg, owner);
+    auto part = Contract(ten, *mpo_part, ctrct_axes);
+    delete mpo_part;
+    auto sum = DistReduceSum(*part, div, owner);
+    delete part;
+    if (owner == rank) {
+      slice = sum;
+    } else {
+      delete sum;
+    }
+  }
+  return slice;
+}
+
+
+// The slice of the new left block is generated from the slice of lblock and
+// the slice of the MPO tensor on its left bond. Each rank only receives the
+// sum over the ranks on the sectors of the right bond of the MPO tensor it
+// owns.
+template <typename TenType>
+TenType *DistGenLeftBlock(
+    const TenType *lblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long site) {
+  auto zero_div = Div(mps_ten) - Div(mps_ten);
+  TenType *new_lblock, *lblock_slice;
+  if (site == 0) {
+    new_lblock = GenLeftBlock(lblock, mps_ten, mpo_ten, site);
+    lblock_slice = GenDistSlice(*new_lblock, 1);
+  } else {
+    auto mpo_slice = GenDistSlice(mpo_ten, 0);
+    new_lblock = GenLeftBlock(lblock, mps_ten, *mpo_slice, site);
+    delete mpo_slice;
+    lblock_slice = DistReduceSlice(*new_lblock, 1, zero_div);
+  }
+  delete new_lblock;
+  return lblock_slice;
+}
+
+
+template <typename TenType>
+TenType *DistGenRightBlock(
+    const TenType *rblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long site, const long N) {
+  auto zero_div = Div(mps_ten) - Div(mps_ten);
+  TenType *new_rblock, *rblock_slice;
+  if (site == N-1) {
+    new_rblock = GenRightBlock(rblock, mps_ten, mpo_ten, site, N);
+    rblock_slice = GenDistSlice(*new_rblock, 1);
+  } else {
+    auto mpo_slice = GenDistSlice(mpo_ten, 3);
+    new_rblock = GenRightBlock(rblock, mps_ten, *mpo_slice, site, N);
+    delete mpo_slice;
+    rblock_slice = DistReduceSlice(*new_rblock, 1, zero_div);
+  }
+  delete new_rblock;
+  return rblock_slice;
+}
+
+
+// The effective Hamiltonian of the rank for the two-site position where. The
+// blocks are the slices of the rank already. The MPO tensors are cut down to
+// the sectors of their bonds to the blocks, except at the chain ends. In the
+// center, the right MPO tensor is cut down on the middle MPO bond instead.
+template <typename TenType>
+std::vector<TenType *> GenDistEffHam(
+    const std::vector<TenType *> &eff_ham, const std::string &where) {
+  auto dist_eff_ham = eff_ham;
+  if (where == "lend") {
+    dist_eff_ham[1] = new TenType(*eff_ham[1]);
+  } else {
+    dist_eff_ham[1] = GenDistSlice(*eff_ham[1], 0);
+  }
+  if (where == "rend") {
+    dist_eff_ham[2] = new TenType(*eff_ham[2]);
+  } else if (where == "lend") {
+    dist_eff_ham[2] = GenDistSlice(*eff_ham[2], 3);
+  } else {
+    dist_eff_ham[2] = GenDistSlice(*eff_ham[2], 0);
+  }
+  return dist_eff_ham;
+}
+
+
+// The sums over the left and the middle MPO bonds are reduced to the owners
+// of the sectors of the middle and the right MPO bonds, so a rank only keeps
+// the intermediates on the sectors it owns. The last sum over the right MPO
+// bond is reduced to all the ranks.
+template <typename TenElemType>
+GQTensor<TenElemType> *dist_eff_ham_mul_state_cent(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto div = Div(*state);
+  auto lres = Contract(*eff_ham[0], *state, {{0}, {0}});
+  auto mid_res = DistCtrctReduceSlice(
+                     *lres, *eff_ham[1], 3, {{0, 2}, {0, 1}}, div);
+  delete lres;
+  auto res = DistCtrctReduceSlice(
+                 *mid_res, *eff_ham[2], 3, {{4, 1}, {0, 1}}, div);
+  delete mid_res;
+  InplaceContract(res, *eff_ham[3], {{4, 1}, {1, 0}});
+  DistAllReduceSum(res, div);
+  return res;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *dist_eff_ham_mul_state_lend(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = eff_ham_mul_state_lend(eff_ham, state);
+  DistAllReduceSum(res, Div(*state));
+  return res;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *dist_eff_ham_mul_state_rend(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = eff_ham_mul_state_rend(eff_ham, state);
+  DistAllReduceSum(res, Div(*state));
+  return res;
+}
+
+
+template <typename TenElemType>
+EffHamMulStateFunc<TenElemType> SelectDistEffHamMulState(
+    const std::string &where) {
+  if (where == "cent") {
+    return &dist_eff_ham_mul_state_cent;
+  } else if (where == "lend") {
+    return &dist_eff_ham_mul_state_lend;
+  } else if (where == "rend") {
+    return &dist_eff_ham_mul_state_rend;
+  } else {
+    std::cout << "The distributed effective Hamiltonian is of the two-site "
+              << "positions, but not of " << where << std::endl;
+    exit(1);
+  }
+}
+} /* gqmps2 */
@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 15:45
+* 
+* Description: GraceQ/MPS2 project. Implementation details for infinite DMRG
+* algorithm.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include <assert.h>
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Forward declarations.
+template <typename TenType>
+std::vector<TenType *> GenRandomCell(
+    const Index &, const Index &, const Index &, const std::vector<QN> &,
+    const long, const unsigned);
+
+template <typename TenType>
+std::vector<TenType *> PredictCell(
+    const std::vector<TenType *> &,
+    const GQTensor<GQTEN_Double> &, const GQTensor<GQTEN_Double> &,
+    const unsigned);
+
+template <typename TenType>
+void RightNormalizeCell(std::vector<TenType *> &, const unsigned);
+
+template <typename TenType>
+GQTensor<GQTEN_Double> *CutCellBond(TenType *&, TenType *&, const unsigned);
+
+template <typename TenType>
+double IdmrgCellSweep(
+    std::vector<TenType *> &, const std::vector<TenType *> &,
+    const TenType *, const TenType *,
+    const IdmrgParams &);
+
+template <typename TenType>
+double IdmrgCellUpdate(
+    const long,
+    std::vector<TenType *> &, const std::vector<TenType *> &,
+    const TenType *, const TenType *,
+    const IdmrgParams &, const char);
+
+
+// Infinite DMRG algorithm.
+template <typename TenType>
+double IdmrgAlgorithm(
+    const std::vector<TenType *> &mpo,
+    const std::vector<long> &stat_labs, const Index &pb_out,
+    const IdmrgParams &params,
+    std::vector<TenType *> &cell) {
+  long L = stat_labs.size();
+  long N = mpo.size();
+  if (L < 2 || L % 2 != 0 || N % L != 0 || N < 3*L) {
+    std::cout << "The unit cell has to be even and the MPO has to be of a "
+              << "multiple of it, at least 3 times, but L = " << L
+              << " and N = " << N << std::endl;
+    exit(1);
+  }
+  // The blocks of the ends have to end with the bonds of the bulk.
+  if (
+      !(mpo[L-1]->indexes.back() == mpo[2*L-1]->indexes.back()) ||
+      !(mpo[N-L]->indexes[0] == mpo[L]->indexes[0])) {
+    std::cout << "The MPO bonds of the first and the last L sites do not "
+              << "match the ones of the bulk" << std::endl;
+    exit(1);
+  }
+  std::vector<QN> qns;
+  for (auto stat_lab : stat_labs) {
+    qns.push_back(pb_out.CoorInterOffsetAndQnsct(stat_lab).qnsct.qn);
+  }
+  auto zero_div = qns[0] - qns[0];
+  auto cell_div = zero_div;
+  for (auto &qn : qns) { cell_div += qn; }
+
+  // The chain starts from the two unit cells at its ends.
+  std::vector<TenType *> mps(2*L), init_mpo(2*L);
+  std::vector<long> init_stat_labs(2*L);
+  for (long x = 0; x < L; ++x) {
+    init_mpo[x] = mpo[x];
+    init_mpo[2*L-1-x] = mpo[N-1-x];
+    init_stat_labs[x] = stat_labs[x];
+    init_stat_labs[2*L-1-x] = stat_labs[L-1-x];
+  }
+  auto sweep_params = SweepParams(
+                          0,
+                          params.Dmin, params.Dmax, params.Cutoff,
+                          false,
+                          kTwoSiteAlgoWorkflowInitial,
+                          params.LanczParams);
+  sweep_params.SvdThreadNum = params.SvdThreadNum;
+  auto e = InfiniteWarmUp(
+                    mps, init_mpo, sweep_params, init_stat_labs, pb_out);
+  auto temp_mps = MPS<TenType>(mps, 0);
+  LeftNormalizeMps(temp_mps, 0, L-2, params.SvdThreadNum);
+  auto cent_s = CutCellBond(mps[L-1], mps[L], params.SvdThreadNum);
+  // The inverse of the singular values of the bond the next cell is
+  // inserted at, for the prediction of the cell after it.
+  auto s_inv = GenInvSvals(*cent_s);
+  delete cent_s;
+  TenType *lblock = nullptr, *rblock = nullptr;
+  for (long x = 0; x < L; ++x) {
+    auto new_lblock = GenLeftBlock(lblock, *mps[x], *init_mpo[x], x);
+    delete lblock;
+    lblock = new_lblock;
+    auto new_rblock = GenRightBlock(
+                          rblock, *mps[2*L-1-x], *init_mpo[2*L-1-x],
+                          2*L-1-x, 2*L);
+    delete rblock;
+    rblock = new_rblock;
+  }
+  auto lvb = InverseIndex(mps[L-1]->indexes.back());
+  auto rvb = InverseIndex(mps[L]->indexes[0]);
+  for (auto &mps_ten : mps) { delete mps_ten; }
+
+  // Insert a unit cell at the center every iteration. The left half of the
+  // cell joins the left block and the other half joins the right block, so
+  // every other cell starts from the middle of the unit cell. The first cell
+  // is random, the others are predicted from the last one.
+  std::cout << "\n";
+  for (auto &cell_ten : cell) { delete cell_ten; }
+  cell.clear();
+  std::vector<QN> cell_divs(L, zero_div);
+  cell_divs[0] = cell_div;
+  cell = GenRandomCell<TenType>(
+             lvb, rvb, pb_out, cell_divs, params.Dmax, params.SvdThreadNum);
+  // The energy per site is taken from the last two cells, which make up a
+  // whole unit cell on each side.
+  auto chain_len = 2*L;
+  std::vector<double> es = {e};
+  double e0 = e / chain_len;
+  double e0_last = 0.0;
+  Timer iter_timer("iter");
+  for (long n = 1; n <= params.Iters; ++n) {
+    iter_timer.Restart();
+    long s = ((n-1) % 2) * (L/2);
+    std::vector<TenType *> cell_mpo(L);
+    for (long j = 0; j < L; ++j) { cell_mpo[j] = mpo[L + (s+j)%L]; }
+
+    for (long sweep = 0; sweep < params.CellSweeps; ++sweep) {
+      e = IdmrgCellSweep(cell, cell_mpo, lblock, rblock, params);
+    }
+    chain_len += L;
+    es.push_back(e);
+    e0_last = e0;
+    if (n == 1) {
+      e0 = (es[1] - es[0]) / L;
+    } else {
+      e0 = (es[n] - es[n-2]) / (2*L);
+    }
+    std::cout << "Iter " << std::setw(5) << n
+              << " N = " << std::setw(8) << chain_len
+              << " E0/site = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << e0
+              << " dE0 = " << std::setprecision(2) << std::scientific << std::abs(e0 - e0_last) << std::fixed
+              << " TotT = " << std::setw(8) << iter_timer.Elapsed();
+    std::cout << std::scientific << std::endl;
+    if (n > 1 && std::abs(e0 - e0_last) < params.EnergyConvTol) {
+      std::cout << "Converged after iteration " << n << "\n" << std::endl;
+      break;
+    }
+    if (n == params.Iters) { break; }
+
+    // The halves of the cell join the blocks.
+    auto absorbed_cell = cell;
+    for (auto &cell_ten : absorbed_cell) {
+      cell_ten = new TenType(*cell_ten);
+    }
+    for (long j = 0; j < L/2-1; ++j) {
+      auto qr_res = BlockQr(
+                        *absorbed_cell[j], 2, 1, zero_div,
+                        false, params.SvdThreadNum);
+      delete absorbed_cell[j];
+      absorbed_cell[j] = qr_res.first;
+      auto next_ten = Contract(
+                          *qr_res.second, *absorbed_cell[j+1], {{1}, {0}});
+      delete qr_res.second;
+      delete absorbed_cell[j+1];
+      absorbed_cell[j+1] = next_ten;
+    }
+    cent_s = CutCellBond(
+                 absorbed_cell[L/2-1], absorbed_cell[L/2],
+                 params.SvdThreadNum);
+    for (long j = 0; j < L/2; ++j) {
+      auto new_lblock = GenBodyLeftBlock(
+                            *lblock, *absorbed_cell[j], *cell_mpo[j]);
+      delete lblock;
+      lblock = new_lblock;
+      auto new_rblock = GenBodyRightBlock(
+                            *rblock, *absorbed_cell[L-1-j], *cell_mpo[L-1-j]);
+      delete rblock;
+      rblock = new_rblock;
+    }
+    for (auto &cell_ten : cell) { delete cell_ten; }
+    cell = PredictCell(absorbed_cell, *cent_s, *s_inv, params.SvdThreadNum);
+    delete s_inv;
+    s_inv = GenInvSvals(*cent_s);
+    delete cent_s;
+    for (auto &cell_ten : absorbed_cell) { delete cell_ten; }
+  }
+  delete s_inv;
+  delete lblock;
+  delete rblock;
+  return e0;
+}
+
+
+// Random unit cell between the bonds lvb and rvb, centered at its first site.
+// The bonds inside are those reachable from both ends, cut to dmax states.
+template <typename TenType>
+std::vector<TenType *> GenRandomCell(
+    const Index &lvb, const Index &rvb, const Index &pb_out,
+    const std::vector<QN> &divs, const long dmax, const unsigned thread_num) {
+  long L = divs.size();
+  std::vector<std::vector<QNSector>> rcaps(L-1);
+  auto caps = rvb.qnscts;
+  for (long j = L-1; j > 0; --j) {
+    caps = GenReachedBondQnScts(caps, pb_out, divs[j], false, dmax);
+    rcaps[j-1] = caps;
+  }
+  std::vector<Index> bonds;
+  caps = lvb.qnscts;
+  for (long j = 0; j < L-1; ++j) {
+    auto lcaps = GenReachedBondQnScts(caps, pb_out, divs[j], true, dmax);
+    std::vector<QNSector> qnscts;
+    for (auto &lcap : lcaps) {
+      for (auto &rcap : rcaps[j]) {
+        if (rcap.qn == lcap.qn) {
+          qnscts.push_back(QNSector(lcap.qn, std::min(lcap.dim, rcap.dim)));
+          break;
+        }
+      }
+    }
+    DimCut(qnscts, dmax, pb_out.dim);
+    bonds.push_back(Index(qnscts, OUT));
+    caps = qnscts;
+  }
+
+  std::vector<TenType *> cell(L);
+  for (long j = 0; j < L; ++j) {
+    cell[j] = new TenType({
+                  (j == 0) ? lvb : InverseIndex(bonds[j-1]),
+                  pb_out,
+                  (j == L-1) ? rvb : bonds[j]});
+    cell[j]->Random(divs[j]);
+  }
+  RightNormalizeCell(cell, thread_num);
+  return cell;
+}
+
+
+// McCulloch's prediction, PRB 77, 035114 (2008) and arXiv:0804.2509, of the
+// cell inserted at the center of the last one, which is cut into the left
+// canonical first half and the right canonical second half by the singular
+// values s. The second half moves to the left of the first one, glued by the
+// inverse singular values s_inv of the bond the last cell was inserted at:
+// s B ... B s_inv A ... A s. The cell is centered at its first site.
+template <typename TenType>
+std::vector<TenType *> PredictCell(
+    const std::vector<TenType *> &last_cell,
+    const GQTensor<GQTEN_Double> &s, const GQTensor<GQTEN_Double> &s_inv,
+    const unsigned thread_num) {
+  long L = last_cell.size();
+  long h = L / 2;
+  std::vector<TenType *> cell(L);
+  for (long j = 0; j < h; ++j) {
+    cell[j] = new TenType(*last_cell[h+j]);
+    cell[h+j] = new TenType(*last_cell[j]);
+  }
+  auto lend = Contract(s, *cell[0], {{1}, {0}});
+  delete cell[0];
+  cell[0] = lend;
+  auto glued = Contract(*cell[h-1], s_inv, {{2}, {0}});
+  delete cell[h-1];
+  cell[h-1] = glued;
+  auto rend = Contract(*cell[L-1], s, {{2}, {0}});
+  delete cell[L-1];
+  cell[L-1] = rend;
+  RightNormalizeCell(cell, thread_num);
+  return cell;
+}
+
+
+// Move the center of the cell to its first site.
+template <typename TenType>
+void RightNormalizeCell(
+    std::vector<TenType *> &cell, const unsigned thread_num) {
+  for (long j = cell.size()-1; j > 0; --j) {
+    auto lq_res = BlockQr(*cell[j], 1, 2, Div(*cell[j]), true, thread_num);
+    delete cell[j];
+    cell[j] = lq_res.second;
+    auto prev_ten = Contract(*cell[j-1], *lq_res.first, {{2}, {0}});
+    delete lq_res.first;
+    delete cell[j-1];
+    cell[j-1] = prev_ten;
+  }
+}
+
+
+// Cut the bond between lten, the center, and the right canonical rten by the
+// untruncated SVD. lten becomes left canonical and rten right canonical, the
+// singular values in between are returned.
+template <typename TenType>
+GQTensor<GQTEN_Double> *CutCellBond(
+    TenType *&lten, TenType *&rten, const unsigned thread_num) {
+  long D = lten->indexes.back().dim;
+  auto zero_div = Div(*lten) - Div(*lten);
+  auto svd_res = BlockSvd(
+                     *lten, lten->indexes.size()-1, 1,
+                     Div(*lten), zero_div,
+                     0.0, D, D, thread_num);
+  delete lten;
+  lten = svd_res.u;
+  auto new_rten = Contract(*svd_res.v, *rten, {{1}, {0}});
+  delete svd_res.v;
+  delete rten;
+  rten = new_rten;
+  return svd_res.s;
+}
+
+
+// Two-site sweep over the unit cell between the blocks, from and back to the
+// first site. The cell sits inside the chain, so the blocks in it are grown
+// by body sites.
+template <typename TenType>
+double IdmrgCellSweep(
+    std::vector<TenType *> &cell, const std::vector<TenType *> &cell_mpo,
+    const TenType *lblock, const TenType *rblock,
+    const IdmrgParams &params) {
+  long L = cell.size();
+  std::vector<const TenType *> lblocks(L-1), rblocks(L-1);
+  lblocks[0] = lblock;
+  rblocks[0] = rblock;
+  for (long k = 1; k < L-1; ++k) {
+    rblocks[k] = GenBodyRightBlock(*rblocks[k-1], *cell[L-k], *cell_mpo[L-k]);
+  }
+
+  double e = 0.0;
+  for (long j = 0; j < L-1; ++j) {
+    e = IdmrgCellUpdate(
+            j, cell, cell_mpo, lblocks[j], rblocks[L-2-j], params, 'r');
+    if (j < L-2) {
+      delete lblocks[j+1];
+      lblocks[j+1] = GenBodyLeftBlock(*lblocks[j], *cell[j], *cell_mpo[j]);
+    }
+  }
+  for (long j = L-2; j >= 0; --j) {
+    e = IdmrgCellUpdate(
+            j, cell, cell_mpo, lblocks[j], rblocks[L-2-j], params, 'l');
+    if (j > 0) {
+      delete rblocks[L-1-j];
+      rblocks[L-1-j] = GenBodyRightBlock(
+                           *rblocks[L-2-j], *cell[j+1], *cell_mpo[j+1]);
+    }
+  }
+  for (long k = 1; k < L-1; ++k) {
+    delete lblocks[k];
+    delete rblocks[k];
+  }
+  return e;
+}
+
+
+template <typename TenType>
+double IdmrgCellUpdate(
+    const long j,
+    std::vector<TenType *> &cell, const std::vector<TenType *> &cell_mpo,
+    const TenType *lblock, const TenType *rblock,
+    const IdmrgParams &params, const char dir) {
+  std::vector<TenType *> eff_ham = {
+      const_cast<TenType *>(lblock), cell_mpo[j], cell_mpo[j+1],
+      const_cast<TenType *>(rblock)};
+  auto init_state = Contract(*cell[j], *cell[j+1], {{2}, {0}});
+  auto lancz_res = LanczosSolver(
+                       eff_ham, init_state, params.LanczParams, "cent");
+  auto svd_res = BlockSvd(
+                     *lancz_res.gs_vec, 2, 2,
+                     Div(*cell[j]), Div(*cell[j+1]),
+                     params.Cutoff, params.Dmin, params.Dmax,
+                     params.SvdThreadNum);
+  delete lancz_res.gs_vec;
+  delete cell[j];
+  delete cell[j+1];
+  if (dir == 'r') {
+    cell[j] = svd_res.u;
+    cell[j+1] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    delete svd_res.v;
+  } else {
+    cell[j] = Contract(*svd_res.u, *svd_res.s, {{2}, {0}});
+    cell[j+1] = svd_res.v;
+    delete svd_res.u;
+  }
+  delete svd_res.s;
+  return lancz_res.gs_eng;
+}
+} /* gqmps2 */
@@ -9,7 +9,15 @@
 #include "gqten/gqten.h"
 
 #include <iostream>
+#include <vector>
+#include <complex>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include <assert.h>
 
 #include "mkl.h"
 
@@ -33,10 +41,40 @@ template <typename TenElemType>
 GQTensor<TenElemType> *eff_ham_mul_state_rend(
     const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
 
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_cent1(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_lend1(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_rend1(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_bond(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
+
 void TridiagGsSolver(
     const std::vector<double> &, const std::vector<double> &, const long,
     double &, double * &, const char);
 
+void TridiagEigenSolver(
+    const std::vector<double> &, const std::vector<double> &, const long,
+    double * &, double * &);
+
+template <typename TenElemType>
+void TridiagExpCoefs(
+    const double *, const double *, const long,
+    const TenElemType,
+    std::vector<TenElemType> &);
+
+void HermEigenSolver(std::vector<GQTEN_Double> &, const long, double *);
+
+void HermEigenSolver(std::vector<GQTEN_Complex> &, const long, double *);
+
 
 // Helpers.
 template <typename TenElemType>
@@ -66,22 +104,184 @@ inline double Real(const double d) { return d; }
 inline double Real(const GQTEN_Complex z) { return z.real(); }
 
 
-// Lanczos solver.
+inline GQTEN_Double Conj(const GQTEN_Double d) { return d; }
+
+
+inline GQTEN_Complex Conj(const GQTEN_Complex z) { return std::conj(z); }
+
+
+// Run func(i) for i in [0, n) on at most thread_num threads. The tasks are
+// handed out one by one, so the run time of the tasks can be unbalanced.
+template <typename FuncType>
+void ParallelFor(const std::size_t n, const unsigned thread_num, FuncType func) {
+  if (thread_num <= 1 || n <= 1) {
+    for (std::size_t i = 0; i < n; ++i) { func(i); }
+    return;
+  }
+  std::atomic<std::size_t> next_task(0);
+  auto worker = [&next_task, n, &func](void) {
+    for (auto i = next_task++; i < n; i = next_task++) { func(i); }
+  };
+  auto worker_num = std::min(static_cast<std::size_t>(thread_num), n);
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < worker_num; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &w : workers) { w.join(); }
+}
+
+
+inline QN IndexFlowQn(const Index &idx, const QN &qn) {
+  if (idx.dir == OUT) { return qn; }
+  return -qn;
+}
+
+
 template <typename TenElemType>
-LanczosRes<TenElemType> LanczosSolver(
+struct SinglePrecElem;
+
+template <>
+struct SinglePrecElem<GQTEN_Double> { using type = float; };
+
+template <>
+struct SinglePrecElem<GQTEN_Complex> { using type = std::complex<float>; };
+
+
+// Single precision copy of a tensor, kept block by block.
+template <typename TenElemType>
+struct SinglePrecTen {
+  std::vector<Index> indexes;
+  std::vector<std::vector<QNSector>> blk_qnscts;
+  std::vector<std::vector<typename SinglePrecElem<TenElemType>::type>> blk_datas;
+};
+
+
+template <typename TenElemType>
+SinglePrecTen<TenElemType> GenSinglePrecTen(const GQTensor<TenElemType> &ten) {
+  using ElemType = typename SinglePrecElem<TenElemType>::type;
+  SinglePrecTen<TenElemType> single_ten;
+  single_ten.indexes = ten.indexes;
+  for (auto &blk : ten.cblocks()) {
+    single_ten.blk_qnscts.push_back(blk->qnscts);
+    single_ten.blk_datas.push_back(
+        std::vector<ElemType>(blk->cdata(), blk->cdata() + blk->size));
+  }
+  return single_ten;
+}
+
+
+// Linear combination of the bases, each of which is in double precision or,
+// if its pointer is nullptr, in single precision. The single precision ones
+// are summed up block by block in double precision.
+template <typename TenElemType>
+GQTensor<TenElemType> *LinearCombineMixedPrecBases(
+    const long n, const double *coefs,
+    const std::vector<GQTensor<TenElemType> *> &bases,
+    const std::vector<SinglePrecTen<TenElemType>> &single_bases) {
+  std::vector<std::vector<QNSector>> sum_blk_qnscts;
+  std::vector<std::vector<TenElemType>> sum_blk_datas;
+  const SinglePrecTen<TenElemType> *single_base0 = nullptr;
+  for (long i = 0; i < n; ++i) {
+    if (bases[i] != nullptr) { continue; }
+    auto &single_base = single_bases[i];
+    if (single_base0 == nullptr) { single_base0 = &single_base; }
+    for (std::size_t j = 0; j < single_base.blk_qnscts.size(); ++j) {
+      auto &qnscts = single_base.blk_qnscts[j];
+      // The bases share the block structure in most cases.
+      std::size_t k = j;
+      if (k >= sum_blk_qnscts.size() || !(sum_blk_qnscts[k] == qnscts)) {
+        for (k = 0; k < sum_blk_qnscts.size(); ++k) {
+          if (sum_blk_qnscts[k] == qnscts) { break; }
+        }
+        if (k == sum_blk_qnscts.size()) {
+          sum_blk_qnscts.push_back(qnscts);
+          sum_blk_datas.push_back(
+              std::vector<TenElemType>(single_base.blk_datas[j].size(), 0.0));
+        }
+      }
+      auto &sum_data = sum_blk_datas[k];
+      auto &data = single_base.blk_datas[j];
+      for (std::size_t l = 0; l < sum_data.size(); ++l) {
+        sum_data[l] += coefs[i] * static_cast<TenElemType>(data[l]);
+      }
+    }
+  }
+
+  GQTensor<TenElemType> *res;
+  if (single_base0 == nullptr) {
+    res = new GQTensor<TenElemType>(bases[0]->indexes);
+  } else {
+    res = new GQTensor<TenElemType>(single_base0->indexes);
+    for (std::size_t k = 0; k < sum_blk_qnscts.size(); ++k) {
+      auto blk = new QNBlock<TenElemType>(sum_blk_qnscts[k]);
+      std::copy(
+          sum_blk_datas[k].begin(), sum_blk_datas[k].end(), blk->data());
+      res->blocks().push_back(blk);
+    }
+  }
+  std::vector<TenElemType> double_coefs;
+  std::vector<GQTensor<TenElemType> *> double_bases;
+  for (long i = 0; i < n; ++i) {
+    if (bases[i] != nullptr) {
+      double_coefs.push_back(coefs[i]);
+      double_bases.push_back(bases[i]);
+    }
+  }
+  if (!double_bases.empty()) { LinearCombine(double_coefs, double_bases, res); }
+  return res;
+}
+
+
+template <typename TenElemType>
+inline TenElemType Overlap(
+    const GQTensor<TenElemType> &lhs, const GQTensor<TenElemType> &rhs,
+    const std::vector<std::vector<long>> &ctrct_axes) {
+  auto overlap_ten = Contract(rhs, Dag(lhs), ctrct_axes);
+  TenElemType overlap = overlap_ten->scalar;
+  delete overlap_ten;
+  return overlap;
+}
+
+
+// Orthogonalize the state to the orthonormal bases, twice for stability, and
+// normalize it. Returns false if nothing is left of the state.
+template <typename TenElemType>
+bool OrthoNormalize(
+    GQTensor<TenElemType> *state,
+    const std::vector<GQTensor<TenElemType> *> &bases,
+    const std::vector<std::vector<long>> &ctrct_axes) {
+  if (state->Normalize() == 0.0) { return false; }
+  for (int pass = 0; pass < 2; ++pass) {
+    for (auto &base : bases) {
+      LinearCombine({-Overlap(*base, *state, ctrct_axes)}, {base}, state);
+    }
+  }
+  return state->Normalize() > kBlockLanczosLinDepTol;
+}
+
+
+template <typename TenElemType>
+using EffHamMulStateFunc = GQTensor<TenElemType> *(*)(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *);
+
+// Defined with the distributed-memory mode.
+template <typename TenElemType>
+EffHamMulStateFunc<TenElemType> SelectDistEffHamMulState(const std::string &);
+
+
+// Select the effective Hamiltonian multiplication for the given position.
+// The effective Hamiltonian is {lblock, lmpo, rmpo, rblock} for the two-site
+// positions "cent", "lend" and "rend", {lblock, mpo, rblock} for the one-site
+// positions "cent1", "lend1" and "rend1" and {lblock, rblock} for "bond".
+// Returns the dimension of the space the effective Hamiltonian acts on.
+template <typename TenElemType>
+long SelectEffHamMulState(
     const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
-    GQTensor<TenElemType> *pinit_state,
-    const LanczosParams &params,
-    const std::string &where) {
-  // Take care that init_state will be destroyed after call the solver.
+    const std::string &where,
+    EffHamMulStateFunc<TenElemType> &eff_ham_mul_state,
+    std::vector<std::vector<long>> &energy_measu_ctrct_axes) {
   long eff_ham_eff_dim = 1;
-  GQTensor<TenElemType> *(* eff_ham_mul_state)(
-      const std::vector<GQTensor<TenElemType> *> &,
-      GQTensor<TenElemType> *) = nullptr;
-  std::vector<std::vector<long>> energy_measu_ctrct_axes;
-  LanczosRes<TenElemType> lancz_res;
-
-  // Calculate position dependent parameters.
   if (where == "cent") {
     eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
     eff_ham_eff_dim *= rpeff_ham[1]->indexes[1].dim;
@@ -101,12 +301,109 @@ LanczosRes<TenElemType> LanczosSolver(
     eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
     eff_ham_mul_state = &eff_ham_mul_state_rend;
     energy_measu_ctrct_axes = {{0, 1, 2}, {0, 1, 2}};
+  } else if (where == "cent1") {
+    eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[1].dim;
+    eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
+    eff_ham_mul_state = &eff_ham_mul_state_cent1;
+    energy_measu_ctrct_axes = {{0, 1, 2}, {0, 1, 2}};
+  } else if (where == "lend1") {
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
+    eff_ham_mul_state = &eff_ham_mul_state_lend1;
+    energy_measu_ctrct_axes = {{0, 1}, {0, 1}};
+  } else if (where == "rend1") {
+    eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
+    eff_ham_mul_state = &eff_ham_mul_state_rend1;
+    energy_measu_ctrct_axes = {{0, 1}, {0, 1}};
+  } else if (where == "bond") {
+    eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
+    eff_ham_mul_state = &eff_ham_mul_state_bond;
+    energy_measu_ctrct_axes = {{0, 1}, {0, 1}};
+  } else {
+    std::cout << "Unknown effective Hamiltonian position " << where
+              << std::endl;
+    exit(1);
+  }
+  return eff_ham_eff_dim;
+}
+
+
+// Multiply the effective Hamiltonian with the penalty
+// penalty_weight * sum_k |penalty_state_k><penalty_state_k| to the state.
+template <typename TenElemType>
+GQTensor<TenElemType> *EffHamMulState(
+    EffHamMulStateFunc<TenElemType> eff_ham_mul_state,
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    GQTensor<TenElemType> *state,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states,
+    const double penalty_weight,
+    const std::vector<std::vector<long>> &ctrct_axes) {
+  auto res = (*eff_ham_mul_state)(rpeff_ham, state);
+  for (auto &penalty_state : penalty_states) {
+    auto overlap_ten = Contract(*state, Dag(*penalty_state), ctrct_axes);
+    TenElemType coef = penalty_weight * overlap_ten->scalar;
+    delete overlap_ten;
+    LinearCombine({coef}, {penalty_state}, res);
+  }
+  return res;
+}
+
+
+// Normalize the ground state of lancz_res, set its energy to the expectation
+// value and return the residual norm ||H v - E v||.
+template <typename TenElemType>
+double LanczosResidualNorm(
+    EffHamMulStateFunc<TenElemType> eff_ham_mul_state,
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states,
+    const double penalty_weight,
+    const std::vector<std::vector<long>> &ctrct_axes,
+    LanczosRes<TenElemType> &lancz_res) {
+  lancz_res.gs_vec->Normalize();
+  auto mat_mul_vec_res = EffHamMulState(
+                             eff_ham_mul_state, rpeff_ham, lancz_res.gs_vec,
+                             penalty_states, penalty_weight, ctrct_axes);
+  auto temp_scalar_ten = Contract(
+      *mat_mul_vec_res, Dag(*lancz_res.gs_vec), ctrct_axes);
+  lancz_res.gs_eng = Real(temp_scalar_ten->scalar); delete temp_scalar_ten;
+  LinearCombine({-lancz_res.gs_eng}, {lancz_res.gs_vec}, mat_mul_vec_res);
+  auto res_norm = mat_mul_vec_res->Normalize();
+  delete mat_mul_vec_res;
+  return res_norm;
+}
+
+
+// Lanczos solver.
+template <typename TenElemType>
+LanczosRes<TenElemType> LanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    GQTensor<TenElemType> *pinit_state,
+    const LanczosParams &params,
+    const std::string &where,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states,
+    const double penalty_weight) {
+  // Take care that init_state will be destroyed after call the solver.
+  EffHamMulStateFunc<TenElemType> eff_ham_mul_state = nullptr;
+  std::vector<std::vector<long>> energy_measu_ctrct_axes;
+  LanczosRes<TenElemType> lancz_res;
+
+  // Calculate position dependent parameters.
+  auto eff_ham_eff_dim = SelectEffHamMulState(
+                             rpeff_ham, where,
+                             eff_ham_mul_state, energy_measu_ctrct_axes);
+  if (params.distributed) {
+    eff_ham_mul_state = SelectDistEffHamMulState<TenElemType>(where);
   }
 
   std::vector<GQTensor<TenElemType> *> bases(params.max_iterations);
   std::vector<double> a(params.max_iterations, 0.0);
   std::vector<double> b(params.max_iterations, 0.0);
   std::vector<double> N(params.max_iterations, 0.0);
+  std::vector<SinglePrecTen<TenElemType>> single_bases;
+  if (params.single_prec_bases) { single_bases.resize(params.max_iterations); }
 
   // Initialize Lanczos iteration.
   pinit_state->Normalize();
@@ -117,7 +414,10 @@ LanczosRes<TenElemType> LanczosSolver(
   mat_vec_timer.Restart();
 #endif
 
-  auto last_mat_mul_vec_res = (*eff_ham_mul_state)(rpeff_ham, bases[0]);
+  auto last_mat_mul_vec_res = EffHamMulState(
+                                  eff_ham_mul_state, rpeff_ham, bases[0],
+                                  penalty_states, penalty_weight,
+                                  energy_measu_ctrct_axes);
 
 #ifdef GQMPS2_TIMING_MODE
   mat_vec_timer.PrintElapsed();
@@ -146,6 +446,13 @@ LanczosRes<TenElemType> LanczosSolver(
           {bases[m-1], bases[m-2]},
           gamma);
     }
+    // With the single precision bases, the ones which the recurrence does not
+    // use anymore are kept in single precision.
+    if (params.single_prec_bases && m >= 2) {
+      single_bases[m-2] = GenSinglePrecTen(*bases[m-2]);
+      delete bases[m-2];
+      bases[m-2] = nullptr;
+    }
     auto norm_gamma = gamma->Normalize();
     double eigval;
     double *eigvec = nullptr;
@@ -155,16 +462,16 @@ LanczosRes<TenElemType> LanczosSolver(
         lancz_res.gs_eng = energy0;
         lancz_res.gs_vec = new GQTensor<TenElemType>(*bases[0]);
         LanczosFree(eigvec, bases, last_mat_mul_vec_res);
-        return lancz_res;
+        break;
       } else {
         TridiagGsSolver(a, b, m, eigval, eigvec, 'V');
-        auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
-        LinearCombine(m, eigvec, bases, gs_vec);
+        auto gs_vec = LinearCombineMixedPrecBases(
+                          m, eigvec, bases, single_bases);
         lancz_res.iters = m;
         lancz_res.gs_eng = energy0;
         lancz_res.gs_vec = gs_vec;
         LanczosFree(eigvec, bases, last_mat_mul_vec_res);
-        return lancz_res;
+        break;
       }
     }
     N[m] = std::pow(norm_gamma, 2.0);
@@ -175,7 +482,10 @@ LanczosRes<TenElemType> LanczosSolver(
     mat_vec_timer.Restart();
 #endif
 
-    last_mat_mul_vec_res = (*eff_ham_mul_state)(rpeff_ham, bases[m]);
+    last_mat_mul_vec_res = EffHamMulState(
+                               eff_ham_mul_state, rpeff_ham, bases[m],
+                               penalty_states, penalty_weight,
+                               energy_measu_ctrct_axes);
 
 #ifdef GQMPS2_TIMING_MODE
     mat_vec_timer.PrintElapsed();
@@ -192,17 +502,274 @@ LanczosRes<TenElemType> LanczosSolver(
          (m == params.max_iterations - 1)) {
       TridiagGsSolver(a, b, m+1, eigval, eigvec, 'V');
       energy0 = energy0_new;
-      auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
-      LinearCombine(m+1, eigvec, bases, gs_vec);
+      auto gs_vec = LinearCombineMixedPrecBases(
+                        m+1, eigvec, bases, single_bases);
       lancz_res.iters = m;
       lancz_res.gs_eng = energy0;
       lancz_res.gs_vec = gs_vec;
       LanczosFree(eigvec, bases, last_mat_mul_vec_res);
-      return lancz_res;
+      break;
     } else {
       energy0 = energy0_new;
     }
   }
+
+  // The ground state combined from the single precision bases is refined by
+  // restarting the Lanczos iterations in double precision from it until its
+  // residual norm is below sqrt(params.error), which bounds the energy error by
+  // about params.error over the gap.
+  if (params.single_prec_bases && lancz_res.iters >= 2) {
+    auto refine_params = params;
+    refine_params.single_prec_bases = false;
+    auto res_tol = std::sqrt(params.error);
+    for (long restart = 0; restart < kLanczosMaxRefineRestarts; ++restart) {
+      auto res_norm = LanczosResidualNorm(
+                          eff_ham_mul_state, rpeff_ham,
+                          penalty_states, penalty_weight,
+                          energy_measu_ctrct_axes,
+                          lancz_res);
+      if (res_norm < res_tol) { break; }
+      auto iters = lancz_res.iters;
+      lancz_res = LanczosSolver(
+                      rpeff_ham, lancz_res.gs_vec,
+                      refine_params,
+                      where,
+                      penalty_states, penalty_weight);
+      lancz_res.iters += iters;
+    }
+  }
+  return lancz_res;
+}
+
+
+// Block Lanczos solver.
+// The Krylov space of the init states block is built with full
+// orthogonalization and the lowest states are the Ritz vectors of the
+// effective Hamiltonian projected into it. The iteration stops when the sum of
+// the lowest energies changes less than params.error or the space dimension
+// reaches params.max_iterations.
+template <typename TenElemType>
+BlockLanczosRes<TenElemType> BlockLanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    const std::vector<GQTensor<TenElemType> *> &pinit_states,
+    const LanczosParams &params,
+    const std::string &where,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states,
+    const double penalty_weight) {
+  // Take care that init_states will be destroyed after call the solver.
+  EffHamMulStateFunc<TenElemType> eff_ham_mul_state = nullptr;
+  std::vector<std::vector<long>> energy_measu_ctrct_axes;
+  auto eff_ham_eff_dim = SelectEffHamMulState(
+                             rpeff_ham, where,
+                             eff_ham_mul_state, energy_measu_ctrct_axes);
+  long target_num = pinit_states.size();
+
+  std::vector<GQTensor<TenElemType> *> bases, mat_mul_bases;
+  std::vector<std::vector<TenElemType>> proj_mat;
+  auto append_bases = [&](const std::vector<GQTensor<TenElemType> *> &states) {
+    for (auto &state : states) {
+      if (
+          (long)bases.size() == std::min(eff_ham_eff_dim, params.max_iterations)
+          || !OrthoNormalize(state, bases, energy_measu_ctrct_axes)) {
+        delete state;
+        continue;
+      }
+      bases.push_back(state);
+      mat_mul_bases.push_back(
+          EffHamMulState(
+              eff_ham_mul_state, rpeff_ham, state,
+              penalty_states, penalty_weight,
+              energy_measu_ctrct_axes));
+      // Only the upper triangle of the projected matrix is used.
+      auto m = bases.size() - 1;
+      for (auto &row : proj_mat) { row.push_back(0.0); }
+      proj_mat.push_back(std::vector<TenElemType>(m+1, 0.0));
+      for (std::size_t i = 0; i <= m; ++i) {
+        proj_mat[i][m] = Overlap(
+                             *bases[i], *mat_mul_bases[m],
+                             energy_measu_ctrct_axes);
+      }
+    }
+  };
+
+  BlockLanczosRes<TenElemType> block_lancz_res;
+  block_lancz_res.iters = 0;
+  append_bases(pinit_states);
+  std::vector<TenElemType> eigvecs;
+  std::vector<double> eigvals;
+  double energy_sum = 0.0;
+  std::size_t block_begin = 0;
+  while (true) {
+    long n = bases.size();
+    eigvecs.resize(n*n);
+    for (long i = 0; i < n; ++i) {
+      for (long j = 0; j < n; ++j) { eigvecs[i*n + j] = proj_mat[i][j]; }
+    }
+    eigvals.resize(n);
+    HermEigenSolver(eigvecs, n, eigvals.data());
+    block_lancz_res.iters += 1;
+
+    double energy_sum_new = 0.0;
+    for (long k = 0; k < std::min(target_num, n); ++k) {
+      energy_sum_new += eigvals[k];
+    }
+    bool converged = (n >= target_num) && (block_lancz_res.iters > 1) &&
+                     ((energy_sum - energy_sum_new) < params.error);
+    energy_sum = energy_sum_new;
+    if (
+        converged ||
+        (n == eff_ham_eff_dim) ||
+        (n == params.max_iterations)) {
+      break;
+    }
+
+    // Next block.
+    std::vector<GQTensor<TenElemType> *> next_block;
+    for (std::size_t i = block_begin; i < bases.size(); ++i) {
+      next_block.push_back(new GQTensor<TenElemType>(*mat_mul_bases[i]));
+    }
+    block_begin = bases.size();
+    append_bases(next_block);
+    if (bases.size() == block_begin) { break; }
+  }
+
+  long n = bases.size();
+  if (n < target_num) {
+    std::cout << "Effective Hamiltonian space is smaller than the "
+              << target_num << " targets." << std::endl;
+    exit(1);
+  }
+  for (long k = 0; k < target_num; ++k) {
+    std::vector<TenElemType> coefs(n);
+    for (long i = 0; i < n; ++i) { coefs[i] = eigvecs[i*n + k]; }
+    auto vec = new GQTensor<TenElemType>(bases[0]->indexes);
+    LinearCombine(coefs, bases, vec);
+    block_lancz_res.engs.push_back(eigvals[k]);
+    block_lancz_res.vecs.push_back(vec);
+  }
+  for (auto &base : bases) { delete base; }
+  for (auto &mat_mul_base : mat_mul_bases) { delete mat_mul_base; }
+  return block_lancz_res;
+}
+
+
+// Lanczos (Krylov space) approximation of exp(coef * H_eff) |init_state>.
+// The Krylov space is enlarged until the estimated error of the result, the
+// norm of the component leaking out of the Krylov space, is smaller than
+// params.error. If params.max_iterations is reached first, the largest part
+// of the remaining step which meets the error is taken in the current Krylov
+// space, and the rest of the step starts a new Krylov space from the result.
+// The error of a one-dimensional Krylov space does not shrink with the step,
+// so params.max_iterations must be at least 2.
+template <typename TenElemType>
+LanczosExpRes<TenElemType> LanczosExpSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    GQTensor<TenElemType> *pinit_state,
+    const TenElemType coef,
+    const LanczosParams &params,
+    const std::string &where) {
+  if (params.max_iterations < 2) {
+    std::cout << "LanczosExpSolver needs max_iterations >= 2, but "
+              << params.max_iterations << std::endl;
+    exit(1);
+  }
+
+  // Take care that init_state will be destroyed after call the solver.
+  EffHamMulStateFunc<TenElemType> eff_ham_mul_state = nullptr;
+  std::vector<std::vector<long>> energy_measu_ctrct_axes;
+  auto eff_ham_eff_dim = SelectEffHamMulState(
+                             rpeff_ham, where,
+                             eff_ham_mul_state, energy_measu_ctrct_axes);
+
+  LanczosExpRes<TenElemType> lancz_exp_res;
+  lancz_exp_res.iters = 0;
+  lancz_exp_res.substeps = 0;
+  lancz_exp_res.err = 0.0;
+
+  std::vector<GQTensor<TenElemType> *> bases(params.max_iterations);
+  std::vector<double> a(params.max_iterations, 0.0);
+  std::vector<double> b(params.max_iterations, 0.0);
+  std::vector<TenElemType> exp_coefs;
+  auto state = pinit_state;
+  double rest = 1.0;      // Rest part of the step.
+  while (rest > 0.0) {
+    auto init_norm = state->Normalize();
+    bases[0] = state;
+    long m = 0;
+    double norm_gamma, err;
+    double *eigvals = nullptr;
+    double *eigvecs = nullptr;
+    while (true) {
+      auto last_mat_mul_vec_res = (*eff_ham_mul_state)(rpeff_ham, bases[m]);
+      auto temp_scalar_ten = Contract(
+          *last_mat_mul_vec_res, Dag(*bases[m]),
+          energy_measu_ctrct_axes);
+      a[m] = Real(temp_scalar_ten->scalar); delete temp_scalar_ten;
+      auto gamma = last_mat_mul_vec_res;
+      if (m == 0) {
+        LinearCombine({-a[m]}, {bases[m]}, gamma);
+      } else {
+        LinearCombine({-a[m], -b[m-1]}, {bases[m], bases[m-1]}, gamma);
+      }
+      norm_gamma = gamma->Normalize();
+
+      delete [] eigvals;
+      delete [] eigvecs;
+      TridiagEigenSolver(a, b, m+1, eigvals, eigvecs);
+      TridiagExpCoefs(eigvals, eigvecs, m+1, rest * coef, exp_coefs);
+      err = norm_gamma * std::abs(exp_coefs[m]);
+      if ((norm_gamma == 0.0) ||
+          (err < params.error) ||
+          (m+1 == eff_ham_eff_dim) ||
+          (m+1 == params.max_iterations)) {
+        delete gamma;
+        break;
+      }
+      b[m] = norm_gamma;
+      m += 1;
+      bases[m] = gamma;
+    }
+
+    // Shrink the substep until the error is small enough.
+    auto substep = rest;
+    while (
+        (norm_gamma != 0.0) &&
+        (m+1 != eff_ham_eff_dim) &&
+        (err >= params.error) &&
+        (substep > kLanczosExpMinSubstep)) {
+      substep /= 2;
+      TridiagExpCoefs(eigvals, eigvecs, m+1, substep * coef, exp_coefs);
+      err = norm_gamma * std::abs(exp_coefs[m]);
+    }
+    if (
+        (norm_gamma != 0.0) &&
+        (m+1 != eff_ham_eff_dim) &&
+        (err >= params.error)) {
+      std::cout << "LanczosExpSolver can not reach the error "
+                << params.error << " with " << m+1
+                << " Krylov vectors, the error of the substep "
+                << substep << " is " << err << std::endl;
+      exit(1);
+    }
+    delete [] eigvals;
+    delete [] eigvecs;
+
+    state = new GQTensor<TenElemType>(bases[0]->indexes);
+    for (auto &exp_coef : exp_coefs) { exp_coef *= init_norm; }
+    LinearCombine(
+        exp_coefs,
+        std::vector<GQTensor<TenElemType> *>(bases.begin(), bases.begin()+m+1),
+        state);
+    for (long i = 0; i <= m; ++i) { delete bases[i]; }
+
+    lancz_exp_res.iters += m+1;
+    lancz_exp_res.substeps += 1;
+    lancz_exp_res.err += err;
+    rest -= substep;
+    if (rest < kLanczosExpMinSubstep) { rest = 0.0; }
+  }
+  lancz_exp_res.res_vec = state;
+  return lancz_exp_res;
 }
 
 
@@ -240,6 +807,47 @@ GQTensor<TenElemType> *eff_ham_mul_state_rend(
 }
 
 
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_cent1(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = Contract(*eff_ham[0], *state, {{0}, {0}});
+  InplaceContract(res, *eff_ham[1], {{0, 2}, {0, 1}});
+  InplaceContract(res, *eff_ham[2], {{1, 3}, {0, 1}});
+  return res;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_lend1(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = Contract(*state, *eff_ham[1], {{0}, {0}});
+  InplaceContract(res, *eff_ham[2], {{0, 1}, {0, 1}});
+  return res;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_rend1(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = Contract(*state, *eff_ham[0], {{0}, {0}});
+  InplaceContract(res, *eff_ham[1], {{0, 1}, {0, 1}});
+  return res;
+}
+
+
+template <typename TenElemType>
+GQTensor<TenElemType> *eff_ham_mul_state_bond(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> *state) {
+  auto res = Contract(*eff_ham[0], *state, {{0}, {0}});
+  InplaceContract(res, *eff_ham[1], {{0, 2}, {1, 0}});
+  return res;
+}
+
+
 inline void TridiagGsSolver(
     const std::vector<double> &a, const std::vector<double> &b, const long n,
     double &gs_eng, double * &gs_vec, const char jobz) {
@@ -294,4 +902,232 @@ inline void TridiagGsSolver(
       exit(1);
   }
 }
-} /* gqmps2 */ 
+
+
+// exp(c * T) e_0 of the n by n tridiagonal matrix T from its eigen
+// decomposition.
+template <typename TenElemType>
+void TridiagExpCoefs(
+    const double *eigvals, const double *eigvecs, const long n,
+    const TenElemType c,
+    std::vector<TenElemType> &exp_coefs) {
+  exp_coefs.assign(n, 0.0);
+  for (long k = 0; k < n; ++k) {
+    auto weight = std::exp(c * eigvals[k]) * eigvecs[k];
+    for (long i = 0; i < n; ++i) {
+      exp_coefs[i] += weight * eigvecs[i*n + k];
+    }
+  }
+}
+
+
+// All the eigenvalues (ascending) and eigenvectors of the n by n tridiagonal
+// matrix. The k-th eigenvector is the k-th column of the row major eigvecs.
+inline void TridiagEigenSolver(
+    const std::vector<double> &a, const std::vector<double> &b, const long n,
+    double * &eigvals, double * &eigvecs) {
+  eigvals = new double [n];
+  std::memcpy(eigvals, a.data(), n*sizeof(double));
+  auto e = new double [n];
+  if (n > 1) { std::memcpy(e, b.data(), (n-1)*sizeof(double)); }
+  eigvecs = new double [n*n];
+  auto info = LAPACKE_dstev(
+                  LAPACK_ROW_MAJOR, 'V',
+                  n,
+                  eigvals, e,
+                  eigvecs,
+                  n);
+  delete [] e;
+  if (info != 0) {
+    std::cout << "?stev error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// All the eigenvalues (ascending) and eigenvectors of the n by n Hermitian
+// matrix. The k-th eigenvector is the k-th column of the row major mat.
+inline void HermEigenSolver(
+    std::vector<GQTEN_Double> &mat, const long n, double *eigvals) {
+  auto info = LAPACKE_dsyev(
+                  LAPACK_ROW_MAJOR, 'V', 'U',
+                  n, mat.data(), n, eigvals);
+  if (info != 0) {
+    std::cout << "?syev error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void HermEigenSolver(
+    std::vector<GQTEN_Complex> &mat, const long n, double *eigvals) {
+  auto info = LAPACKE_zheev(
+                  LAPACK_ROW_MAJOR, 'V', 'U',
+                  n, mat.data(), n, eigvals);
+  if (info != 0) {
+    std::cout << "?heev error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// The k largest eigenvalues (ascending) and their eigenvectors of the n by n
+// Hermitian matrix, which is destroyed. The eigenvectors are the columns of
+// the row major n by k eigvecs.
+inline void HermTopEigenSolver(
+    std::vector<GQTEN_Double> &mat, const long n, const long k,
+    double *eigvals, std::vector<GQTEN_Double> &eigvecs) {
+  eigvecs.resize(n*k);
+  std::vector<lapack_int> isuppz(2*n);
+  lapack_int m;
+  auto info = LAPACKE_dsyevr(
+                  LAPACK_ROW_MAJOR, 'V', 'I', 'U',
+                  n, mat.data(), n,
+                  0.0, 0.0, n-k+1, n, 0.0,
+                  &m, eigvals, eigvecs.data(), k, isuppz.data());
+  if (info != 0) {
+    std::cout << "?syevr error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void HermTopEigenSolver(
+    std::vector<GQTEN_Complex> &mat, const long n, const long k,
+    double *eigvals, std::vector<GQTEN_Complex> &eigvecs) {
+  eigvecs.resize(n*k);
+  std::vector<lapack_int> isuppz(2*n);
+  lapack_int m;
+  auto info = LAPACKE_zheevr(
+                  LAPACK_ROW_MAJOR, 'V', 'I', 'U',
+                  n, mat.data(), n,
+                  0.0, 0.0, n-k+1, n, 0.0,
+                  &m, eigvals, eigvecs.data(), k, isuppz.data());
+  if (info != 0) {
+    std::cout << "?heevr error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// The upper triangle of mat mat^dag, if left is true, or of mat^dag mat, where
+// mat is the row major m by n matrix. The result is row major.
+inline void MatGram(
+    const std::vector<GQTEN_Double> &mat, const long m, const long n,
+    const bool left, std::vector<GQTEN_Double> &gram) {
+  auto dim = left ? m : n;
+  gram.assign(dim*dim, 0.0);
+  cblas_dsyrk(
+      CblasRowMajor, CblasUpper, left ? CblasNoTrans : CblasTrans,
+      dim, left ? n : m,
+      1.0, mat.data(), n,
+      0.0, gram.data(), dim);
+}
+
+
+inline void MatGram(
+    const std::vector<GQTEN_Complex> &mat, const long m, const long n,
+    const bool left, std::vector<GQTEN_Complex> &gram) {
+  auto dim = left ? m : n;
+  gram.assign(dim*dim, 0.0);
+  cblas_zherk(
+      CblasRowMajor, CblasUpper, left ? CblasNoTrans : CblasConjTrans,
+      dim, left ? n : m,
+      1.0, mat.data(), n,
+      0.0, gram.data(), dim);
+}
+
+
+// Thin SVD of the row major m by n matrix, which is destroyed. The singular
+// values are descending, u is m by min(m, n) and vt is min(m, n) by n, both
+// row major.
+inline void MatSvdSolver(
+    std::vector<GQTEN_Double> &mat, const long m, const long n,
+    double *svals,
+    std::vector<GQTEN_Double> &u, std::vector<GQTEN_Double> &vt) {
+  auto k = std::min(m, n);
+  u.resize(m*k);
+  vt.resize(k*n);
+  auto info = LAPACKE_dgesdd(
+                  LAPACK_ROW_MAJOR, 'S',
+                  m, n, mat.data(), n,
+                  svals, u.data(), k, vt.data(), n);
+  if (info != 0) {
+    std::cout << "?gesdd error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void MatSvdSolver(
+    std::vector<GQTEN_Complex> &mat, const long m, const long n,
+    double *svals,
+    std::vector<GQTEN_Complex> &u, std::vector<GQTEN_Complex> &vt) {
+  auto k = std::min(m, n);
+  u.resize(m*k);
+  vt.resize(k*n);
+  auto info = LAPACKE_zgesdd(
+                  LAPACK_ROW_MAJOR, 'S',
+                  m, n, mat.data(), n,
+                  svals, u.data(), k, vt.data(), n);
+  if (info != 0) {
+    std::cout << "?gesdd error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// Thin QR decomposition of the row major m by n matrix, which is destroyed.
+// q is m by min(m, n) with orthonormal columns and r is min(m, n) by n, both
+// row major.
+inline void MatQrSolver(
+    std::vector<GQTEN_Double> &mat, const long m, const long n,
+    std::vector<GQTEN_Double> &q, std::vector<GQTEN_Double> &r) {
+  auto k = std::min(m, n);
+  std::vector<GQTEN_Double> tau(k);
+  auto info = LAPACKE_dgeqrf(LAPACK_ROW_MAJOR, m, n, mat.data(), n, tau.data());
+  if (info != 0) {
+    std::cout << "?geqrf error." << std::endl;
+    exit(1);
+  }
+  r.assign(k*n, 0.0);
+  for (long i = 0; i < k; ++i) {
+    for (long j = i; j < n; ++j) { r[i*n + j] = mat[i*n + j]; }
+  }
+  info = LAPACKE_dorgqr(LAPACK_ROW_MAJOR, m, k, k, mat.data(), n, tau.data());
+  if (info != 0) {
+    std::cout << "?orgqr error." << std::endl;
+    exit(1);
+  }
+  q.resize(m*k);
+  for (long i = 0; i < m; ++i) {
+    for (long j = 0; j < k; ++j) { q[i*k + j] = mat[i*n + j]; }
+  }
+}
+
+
+inline void MatQrSolver(
+    std::vector<GQTEN_Complex> &mat, const long m, const long n,
+    std::vector<GQTEN_Complex> &q, std::vector<GQTEN_Complex> &r) {
+  auto k = std::min(m, n);
+  std::vector<GQTEN_Complex> tau(k);
+  auto info = LAPACKE_zgeqrf(LAPACK_ROW_MAJOR, m, n, mat.data(), n, tau.data());
+  if (info != 0) {
+    std::cout << "?geqrf error." << std::endl;
+    exit(1);
+  }
+  r.assign(k*n, 0.0);
+  for (long i = 0; i < k; ++i) {
+    for (long j = i; j < n; ++j) { r[i*n + j] = mat[i*n + j]; }
+  }
+  info = LAPACKE_zungqr(LAPACK_ROW_MAJOR, m, k, k, mat.data(), n, tau.data());
+  if (info != 0) {
+    std::cout << "?ungqr error." << std::endl;
+    exit(1);
+  }
+  q.resize(m*k);
+  for (long i = 0; i < m; ++i) {
+    for (long j = 0; j < k; ++j) { q[i*k + j] = mat[i*n + j]; }
+  }
+}
+} /* gqmps2 */
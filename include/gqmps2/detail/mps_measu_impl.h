@@ -12,6 +12,10 @@
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
 
 
 namespace gqmps2 {
@@ -32,15 +36,36 @@ MeasuResElem<TenElemType> MultiSiteOpAvg(
     const GQTensor<TenElemType> &,
     const std::vector<long> &);
 
+template <typename TenElemType, typename AvgType>
+void TwoSiteOpAvgSweep(
+    MPS<GQTensor<TenElemType>> &,
+    const std::vector<GQTensor<TenElemType>> &,
+    const GQTensor<TenElemType> &,
+    const GQTensor<TenElemType> &,
+    const std::vector<std::vector<long>> &,
+    const std::vector<std::size_t> &,
+    MeasuRes<AvgType> &);
+
+template <typename TenType>
+TenType *CtrctHeadTen(const MPS<TenType> &, const long, const TenType &);
+
 template <typename TenType>
 void CtrctMidTen(
     const MPS<TenType> &, const long,
     const TenType &, const TenType &,
     TenType * &);
 
+template <typename TenType>
+TenType *CtrctTailTen(
+    const MPS<TenType> &, const long, const TenType &, const TenType &);
+
 template <typename AvgType>
 void DumpMeasuRes(const MeasuRes<AvgType> &, const std::string &);
 
+template <typename AvgType>
+std::vector<MeasuResWriter<AvgType> *> GenMeasuResWriters(
+    const std::vector<std::string> &, const char);
+
 
 // Helpers.
 inline bool IsOrderKept(const std::vector<long> &sites) {
@@ -77,27 +102,98 @@ inline void DumpAvgVal(std::ofstream &ofs, const GQTEN_Complex avg) {
 }
 
 
+// Group the measurement events by their head sites. The groups are ordered by
+// the head site. The events in a group keep the order of sites_set, or are
+// sorted by their sites when sort_sites is true.
+inline std::vector<std::vector<std::size_t>> GroupMeasuEventsByHeadSite(
+    const std::vector<std::vector<long>> &sites_set, const bool sort_sites) {
+  std::vector<std::size_t> evt_idxs(sites_set.size());
+  for (std::size_t i = 0; i < evt_idxs.size(); ++i) { evt_idxs[i] = i; }
+  std::stable_sort(
+      evt_idxs.begin(), evt_idxs.end(),
+      [&sites_set, sort_sites](const std::size_t lhs, const std::size_t rhs) {
+        if (sort_sites) { return sites_set[lhs] < sites_set[rhs]; }
+        return sites_set[lhs][0] < sites_set[rhs][0];
+      });
+  std::vector<std::vector<std::size_t>> grps;
+  for (auto evt_idx : evt_idxs) {
+    if (grps.empty() || sites_set[grps.back()[0]][0] != sites_set[evt_idx][0]) {
+      grps.emplace_back();
+    }
+    grps.back().push_back(evt_idx);
+  }
+  return grps;
+}
+
+
+template <typename TenType>
+std::vector<TenType> DerefTens(
+    const std::vector<const TenType *> &tens,
+    const std::size_t begin, const std::size_t end) {
+  std::vector<TenType> deref_tens;
+  for (auto i = begin; i < end; ++i) { deref_tens.push_back(*tens[i]); }
+  return deref_tens;
+}
+
+
+// Run measure(mps, ops) on the real copies of the MPS and the operators if the
+// operators are real and the sites of the MPS are real up to their phases,
+// which cancel in the averages. The MPS is then left as it is.
+template <typename TenElemType, typename MeasureFuncType>
+void MeasureInRealIfReal(
+    MPS<GQTensor<TenElemType>> &mps,
+    const std::vector<const GQTensor<TenElemType> *> &ops,
+    MeasureFuncType measure) {
+  using RealTenType = GQTensor<GQTEN_Double>;
+  std::vector<RealTenType *> real_ops, real_mps_tens;
+  if (
+      !GenRealTens(ops, false, real_ops) ||
+      !GenRealTens(mps.tens, true, real_mps_tens)) {
+    for (auto &real_op : real_ops) { delete real_op; }
+    measure(mps, ops);
+    return;
+  }
+  MPS<RealTenType> real_mps(real_mps_tens, mps.center);
+  measure(
+      real_mps,
+      std::vector<const RealTenType *>(real_ops.begin(), real_ops.end()));
+  for (auto &real_mps_ten : real_mps.tens) { delete real_mps_ten; }
+  for (auto &real_op : real_ops) { delete real_op; }
+}
+
+
 // Measure one-site operator.
 template <typename TenElemType>
 MeasuRes<TenElemType> MeasureOneSiteOp(
     MPS<GQTensor<TenElemType>> &mps,
-    const GQTensor<TenElemType> &op, const std::string &res_file_basename) {
+    const GQTensor<TenElemType> &op, const std::string &res_file_basename,
+    const char res_file_format) {
   auto N = mps.N;
   MeasuRes<TenElemType> measu_res(N);
-  for (std::size_t i = 0; i < N; ++i) {
-    CentralizeMps(mps, i);
-    measu_res[i] = OneSiteOpAvg(*mps.tens[i], op, i, N);
-  }
-  DumpMeasuRes(measu_res, res_file_basename);
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+  MeasureInRealIfReal(
+      mps, {&op},
+      [N, &measu_res, &writer](auto &measu_mps, const auto &measu_ops) {
+        for (std::size_t i = 0; i < N; ++i) {
+          CentralizeMps(measu_mps, i);
+          measu_res[i] = OneSiteOpAvg(*measu_mps.tens[i], *measu_ops[0], i, N);
+          writer.Write(i, measu_res[i]);
+        }
+      });
+  writer.Close(measu_res);
   return measu_res;
 }
 
 
+// The operators are measured in parallel on the centralized MPS when
+// thread_num > 1. The results do not depend on thread_num.
 template <typename TenElemType>
 MeasuResSet<TenElemType> MeasureOneSiteOp(
     MPS<GQTensor<TenElemType>> &mps,
     const std::vector<GQTensor<TenElemType>> &ops,
-    const std::vector<std::string> &res_file_basenames) {
+    const std::vector<std::string> &res_file_basenames,
+    const unsigned thread_num,
+    const char res_file_format) {
   auto op_num = ops.size();
   assert(op_num == res_file_basenames.size());
   auto N = mps.N;
@@ -105,14 +201,29 @@ MeasuResSet<TenElemType> MeasureOneSiteOp(
   for (auto &measu_res : measu_res_set) {
     measu_res = MeasuRes<TenElemType>(N);
   }
-  for (std::size_t i = 0; i < N; ++i) {
-    CentralizeMps(mps, i);
-    for (std::size_t j = 0; j < op_num; ++j) {
-      measu_res_set[j][i] = OneSiteOpAvg(*mps.tens[i], ops[j], i, N);
-    }
-  }
+  auto writers = GenMeasuResWriters<TenElemType>(
+                     res_file_basenames, res_file_format);
+  std::vector<const GQTensor<TenElemType> *> op_ptrs;
+  for (auto &op : ops) { op_ptrs.push_back(&op); }
+  MeasureInRealIfReal(
+      mps, op_ptrs,
+      [&](auto &measu_mps, const auto &measu_ops) {
+        for (std::size_t i = 0; i < N; ++i) {
+          CentralizeMps(measu_mps, i);
+          ParallelFor(
+              op_num, thread_num,
+              [&measu_mps, &measu_ops, &measu_res_set, &writers, i, N](
+                  const std::size_t j) {
+                measu_res_set[j][i] = OneSiteOpAvg(
+                                          *measu_mps.tens[i], *measu_ops[j],
+                                          i, N);
+                writers[j]->Write(i, measu_res_set[j][i]);
+              });
+        }
+      });
   for (std::size_t i = 0; i < op_num; ++i) {
-    DumpMeasuRes(measu_res_set[i], res_file_basenames[i]);
+    writers[i]->Close(measu_res_set[i]);
+    delete writers[i];
   }
   return measu_res_set;
 }
@@ -126,26 +237,47 @@ MeasuRes<TenElemType> MeasureTwoSiteOp(
     const GQTensor<TenElemType> &inst_op,
     const GQTensor<TenElemType> &id_op,
     const std::vector<std::vector<long>> &sites_set,
-    const std::string &res_file_basename) {
+    const std::string &res_file_basename,
+    const char res_file_format) {
   assert(phys_ops.size() == 2);
   auto measu_event_num = sites_set.size();
-  std::vector<std::vector<GQTensor<TenElemType>>> phys_ops_set(
-                                                      measu_event_num,
-                                                      phys_ops);
-  std::vector<std::vector<GQTensor<TenElemType>>> inst_ops_set(
-                                                      measu_event_num,
-                                                      {inst_op});
-  return MeasureMultiSiteOp(
-             mps,
-             phys_ops_set,
-             inst_ops_set,
-             id_op,
-             sites_set,
-             res_file_basename);
+  MeasuRes<TenElemType> measu_res(measu_event_num);
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+
+  for (auto &sites : sites_set) {
+    assert(sites.size() == 2);
+    assert(sites[0] < sites[1]);
+  }
+
+  // Sort the events by head site and then by tail site. All the events which
+  // share the same head site are measured by one sweep to the right.
+  auto grps = GroupMeasuEventsByHeadSite(sites_set, true);
+  MeasureInRealIfReal(
+      mps, {&phys_ops[0], &phys_ops[1], &inst_op, &id_op},
+      [&](auto &measu_mps, const auto &measu_ops) {
+        auto measu_phys_ops = DerefTens(measu_ops, 0, 2);
+        for (auto &grp : grps) {
+          CentralizeMps(measu_mps, sites_set[grp[0]][0]);
+          TwoSiteOpAvgSweep(
+              measu_mps,
+              measu_phys_ops, *measu_ops[2], *measu_ops[3],
+              sites_set, grp,
+              measu_res);
+          for (auto evt_idx : grp) {
+            writer.Write(evt_idx, measu_res[evt_idx]);
+          }
+        }
+      });
+  writer.Close(measu_res);
+  return measu_res;
 }
 
 
 // Measure multi-site operator.
+// The events are grouped by their head sites. The MPS is centralized once for
+// each group and the events in the group, which only read the MPS, are
+// measured in parallel when thread_num > 1. The results keep the order of
+// sites_set and do not depend on thread_num.
 template <typename TenElemType>
 MeasuRes<TenElemType> MeasureMultiSiteOp(
     MPS<GQTensor<TenElemType>> &mps,
@@ -153,19 +285,235 @@ MeasuRes<TenElemType> MeasureMultiSiteOp(
     const std::vector<std::vector<GQTensor<TenElemType>>> &inst_ops_set,
     const GQTensor<TenElemType> &id_op,
     const std::vector<std::vector<long>> &sites_set,
-    const std::string &res_file_basename) {
+    const std::string &res_file_basename,
+    const unsigned thread_num,
+    const char res_file_format) {
   auto measu_event_num = sites_set.size();
   MeasuRes<TenElemType> measu_res(measu_event_num);
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+  for (auto &sites : sites_set) {
+    assert(sites.size() > 1);
+    assert(IsOrderKept(sites));
+  }
+
+  // The operators of all the events are checked for the real measurement in
+  // one list, which ends with id_op.
+  std::vector<const GQTensor<TenElemType> *> op_ptrs;
   for (std::size_t i = 0; i < measu_event_num; ++i) {
-    auto &phys_ops = phys_ops_set[i];
-    auto &inst_ops = inst_ops_set[i];
-    auto &sites = sites_set[i];
+    for (auto &op : phys_ops_set[i]) { op_ptrs.push_back(&op); }
+    for (auto &op : inst_ops_set[i]) { op_ptrs.push_back(&op); }
+  }
+  op_ptrs.push_back(&id_op);
+  auto grps = GroupMeasuEventsByHeadSite(sites_set, false);
+  MeasureInRealIfReal(
+      mps, op_ptrs,
+      [&](auto &measu_mps, const auto &measu_ops) {
+        std::vector<decltype(DerefTens(measu_ops, 0, 0))>
+            measu_phys_ops_set, measu_inst_ops_set;
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < measu_event_num; ++i) {
+          auto phys_op_num = phys_ops_set[i].size();
+          auto inst_op_num = inst_ops_set[i].size();
+          measu_phys_ops_set.push_back(
+              DerefTens(measu_ops, offset, offset + phys_op_num));
+          offset += phys_op_num;
+          measu_inst_ops_set.push_back(
+              DerefTens(measu_ops, offset, offset + inst_op_num));
+          offset += inst_op_num;
+        }
+        auto &measu_id_op = *measu_ops.back();
+        for (auto &grp : grps) {
+          CentralizeMps(measu_mps, sites_set[grp[0]][0]);
+          ParallelFor(
+              grp.size(), thread_num,
+              [&](const std::size_t j) {
+                auto evt_idx = grp[j];
+                measu_res[evt_idx] = MultiSiteOpAvg(
+                                         measu_mps,
+                                         measu_phys_ops_set[evt_idx],
+                                         measu_inst_ops_set[evt_idx],
+                                         measu_id_op,
+                                         sites_set[evt_idx]);
+                writer.Write(evt_idx, measu_res[evt_idx]);
+              });
+        }
+      });
+  writer.Close(measu_res);
+  return measu_res;
+}
+
+
+// Measurement session.
+// The MPS is copied and right normalized once. Then the canonical center is
+// swept from left to right once, keeping the center tensor of every site and
+// the singular values of every bond. A query centralized at site i only needs
+// the right normalized tensors with the i-th one replaced by the i-th center
+// tensor, so no query changes the stored tensors and the queries can run in
+// parallel.
+template <typename TenElemType>
+MeasuSession<TenElemType>::MeasuSession(
+    const std::vector<GQTensor<TenElemType> *> &mps_tens) :
+    N(mps_tens.size()),
+    rtens_(mps_tens.size()),
+    cent_tens_(mps_tens.size()),
+    svals_(mps_tens.size()-1) {
+  using TenType = GQTensor<TenElemType>;
+  assert(N > 1);
+  for (std::size_t i = 0; i < N; ++i) {
+    rtens_[i] = new TenType(*mps_tens[i]);
+  }
+  MPS<TenType> rmps(rtens_, -1);
+  RightNormalizeMps(rmps, N-1, 1);
+
+  cent_tens_[0] = new TenType(*rtens_[0]);
+  for (std::size_t i = 0; i < N-1; ++i) {
+    long ldims = (i == 0) ? 1 : 2;
+    auto svd_res = Svd(
+                       *cent_tens_[i],
+                       ldims, 1,
+                       Div(*cent_tens_[i]), Div(*rtens_[i+1]));
+    delete svd_res.u;
+    svals_[i] = svd_res.s;
+    auto temp_ten = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    delete svd_res.v;
+    cent_tens_[i+1] = Contract(*temp_ten, *rtens_[i+1], {{1}, {0}});
+    delete temp_ten;
+  }
+}
+
+
+template <typename TenElemType>
+MeasuSession<TenElemType>::~MeasuSession(void) {
+  for (auto &t : rtens_) { delete t; }
+  for (auto &t : cent_tens_) { delete t; }
+  for (auto &s : svals_) { delete s; }
+}
+
+
+template <typename TenElemType>
+std::vector<GQTensor<TenElemType> *>
+MeasuSession<TenElemType>::CentView(const long site) const {
+  auto view = rtens_;
+  view[site] = cent_tens_[site];
+  return view;
+}
+
+
+template <typename TenElemType>
+MeasuRes<TenElemType> MeasuSession<TenElemType>::MeasureOneSiteOp(
+    const GQTensor<TenElemType> &op,
+    const std::string &res_file_basename,
+    const unsigned thread_num,
+    const char res_file_format) {
+  MeasuRes<TenElemType> measu_res(N);
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+  ParallelFor(
+      N, thread_num,
+      [this, &op, &measu_res, &writer](const std::size_t i) {
+        measu_res[i] = OneSiteOpAvg(*cent_tens_[i], op, i, N);
+        writer.Write(i, measu_res[i]);
+      });
+  writer.Close(measu_res);
+  return measu_res;
+}
+
+
+template <typename TenElemType>
+MeasuResSet<TenElemType> MeasuSession<TenElemType>::MeasureOneSiteOp(
+    const std::vector<GQTensor<TenElemType>> &ops,
+    const std::vector<std::string> &res_file_basenames,
+    const unsigned thread_num,
+    const char res_file_format) {
+  auto op_num = ops.size();
+  assert(op_num == res_file_basenames.size());
+  MeasuResSet<TenElemType> measu_res_set(op_num);
+  for (auto &measu_res : measu_res_set) {
+    measu_res = MeasuRes<TenElemType>(N);
+  }
+  auto writers = GenMeasuResWriters<TenElemType>(
+                     res_file_basenames, res_file_format);
+  ParallelFor(
+      N, thread_num,
+      [this, &ops, &measu_res_set, &writers, op_num](const std::size_t i) {
+        for (std::size_t j = 0; j < op_num; ++j) {
+          measu_res_set[j][i] = OneSiteOpAvg(*cent_tens_[i], ops[j], i, N);
+          writers[j]->Write(i, measu_res_set[j][i]);
+        }
+      });
+  for (std::size_t i = 0; i < op_num; ++i) {
+    writers[i]->Close(measu_res_set[i]);
+    delete writers[i];
+  }
+  return measu_res_set;
+}
+
+
+template <typename TenElemType>
+MeasuRes<TenElemType> MeasuSession<TenElemType>::MeasureTwoSiteOp(
+    const std::vector<GQTensor<TenElemType>> &phys_ops,
+    const GQTensor<TenElemType> &inst_op,
+    const GQTensor<TenElemType> &id_op,
+    const std::vector<std::vector<long>> &sites_set,
+    const std::string &res_file_basename,
+    const unsigned thread_num,
+    const char res_file_format) {
+  assert(phys_ops.size() == 2);
+  for (auto &sites : sites_set) {
+    assert(sites.size() == 2);
+    assert(sites[0] < sites[1]);
+  }
+  MeasuRes<TenElemType> measu_res(sites_set.size());
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+  auto grps = GroupMeasuEventsByHeadSite(sites_set, true);
+  ParallelFor(
+      grps.size(), thread_num,
+      [&, this](const std::size_t g) {
+        auto head_site = sites_set[grps[g][0]][0];
+        auto view = CentView(head_site);
+        MPS<GQTensor<TenElemType>> mps(view, head_site);
+        TwoSiteOpAvgSweep(
+            mps,
+            phys_ops, inst_op, id_op,
+            sites_set, grps[g],
+            measu_res);
+        for (auto evt_idx : grps[g]) {
+          writer.Write(evt_idx, measu_res[evt_idx]);
+        }
+      });
+  writer.Close(measu_res);
+  return measu_res;
+}
+
+
+template <typename TenElemType>
+MeasuRes<TenElemType> MeasuSession<TenElemType>::MeasureMultiSiteOp(
+    const std::vector<std::vector<GQTensor<TenElemType>>> &phys_ops_set,
+    const std::vector<std::vector<GQTensor<TenElemType>>> &inst_ops_set,
+    const GQTensor<TenElemType> &id_op,
+    const std::vector<std::vector<long>> &sites_set,
+    const std::string &res_file_basename,
+    const unsigned thread_num,
+    const char res_file_format) {
+  for (auto &sites : sites_set) {
     assert(sites.size() > 1);
     assert(IsOrderKept(sites));
-    CentralizeMps(mps, sites[0]);
-    measu_res[i] = MultiSiteOpAvg(mps, phys_ops, inst_ops, id_op, sites);
   }
-  DumpMeasuRes(measu_res, res_file_basename);
+  MeasuRes<TenElemType> measu_res(sites_set.size());
+  MeasuResWriter<TenElemType> writer(res_file_basename, res_file_format);
+  ParallelFor(
+      sites_set.size(), thread_num,
+      [&, this](const std::size_t i) {
+        auto head_site = sites_set[i][0];
+        auto view = CentView(head_site);
+        MPS<GQTensor<TenElemType>> mps(view, head_site);
+        measu_res[i] = MultiSiteOpAvg(
+                           mps,
+                           phys_ops_set[i], inst_ops_set[i],
+                           id_op,
+                           sites_set[i]);
+        writer.Write(i, measu_res[i]);
+      });
+  writer.Close(measu_res);
   return measu_res;
 }
 
@@ -179,7 +527,7 @@ MeasuResElem<TenElemType> OneSiteOpAvg(
   std::vector<long> ta_ctrct_axes2, tb_ctrct_axes2;
   if (site == 0) {
     ta_ctrct_axes1 = {0};
-    tb_ctrct_axes1 = {1};
+    tb_ctrct_axes1 = {0};
     ta_ctrct_axes2 = {0, 1};
     tb_ctrct_axes2 = {1, 0};
   } else if (site == (N-1)) {
@@ -212,25 +560,7 @@ MeasuResElem<TenElemType> MultiSiteOpAvg(
     const GQTensor<TenElemType> &id_op,
     const std::vector<long> &sites) {
   // Deal with head tensor.
-  std::vector<long> head_mps_ten_ctrct_axes1;
-  std::vector<long> head_mps_ten_ctrct_axes2;
-  std::vector<long> head_mps_ten_ctrct_axes3;
-  if (sites[0] == 0) {
-    head_mps_ten_ctrct_axes1 = {0};
-    head_mps_ten_ctrct_axes2 = {1};
-    head_mps_ten_ctrct_axes3 = {0};
-  } else {
-    head_mps_ten_ctrct_axes1 = {1};
-    head_mps_ten_ctrct_axes2 = {0, 2};
-    head_mps_ten_ctrct_axes3 = {0, 1};
-  }
-  auto temp_ten0 = Contract(
-                       *mps.tens[sites[0]], phys_ops[0],
-                       {head_mps_ten_ctrct_axes1, {0}});
-  auto temp_ten = Contract(
-                       *temp_ten0, Dag(*mps.tens[sites[0]]),
-                       {head_mps_ten_ctrct_axes2, head_mps_ten_ctrct_axes3});
-  delete temp_ten0;
+  auto temp_ten = CtrctHeadTen(mps, sites[0], phys_ops[0]);
 
   // Deal with middle tensors.
   auto inst_op_num = inst_ops.size();
@@ -246,31 +576,72 @@ MeasuResElem<TenElemType> MultiSiteOpAvg(
   }
 
   // Deal with tail tensor.
-  std::vector<long> tail_mps_ten_ctrct_axes1;
-  std::vector<long> tail_mps_ten_ctrct_axes2;
-  if (sites.back() == mps.N-1) {
-    tail_mps_ten_ctrct_axes1 = {0, 1}; 
-    tail_mps_ten_ctrct_axes2 = {1, 0};
-  } else {
-    tail_mps_ten_ctrct_axes1 = {0, 1, 2};
-    tail_mps_ten_ctrct_axes2 = {2, 0, 1};
-  }
-  auto temp_ten2 = Contract(
-                       *mps.tens[sites[inst_op_num]], *temp_ten, 
-                       {{0}, {0}});
+  auto res_ten = CtrctTailTen(
+                     mps, sites[inst_op_num],
+                     phys_ops[phys_op_num-1], *temp_ten);
   delete temp_ten;
-  auto temp_ten3 = Contract(*temp_ten2, phys_ops[phys_op_num-1], {{0}, {0}});
-  delete temp_ten2;
-  auto res_ten = Contract(
-                     *temp_ten3, Dag(*mps.tens[sites[phys_op_num-1]]),
-                     {tail_mps_ten_ctrct_axes1, tail_mps_ten_ctrct_axes2});
-  delete temp_ten3;
   auto avg = res_ten->scalar;
   delete res_ten;
   return MeasuResElem<TenElemType>(sites, avg);
 }
 
 
+// Measure a group of two-site events which share the same head site. The MPS
+// must be centralized at the head site. The transfer tensor is extended to the
+// right site by site and closed once at every tail site, so the whole group
+// costs O(N) contractions instead of O(N) for each event.
+template <typename TenElemType, typename AvgType>
+void TwoSiteOpAvgSweep(
+    MPS<GQTensor<TenElemType>> &mps,
+    const std::vector<GQTensor<TenElemType>> &phys_ops,
+    const GQTensor<TenElemType> &inst_op,
+    const GQTensor<TenElemType> &id_op,
+    const std::vector<std::vector<long>> &sites_set,
+    const std::vector<std::size_t> &sorted_evt_idxs,
+    MeasuRes<AvgType> &measu_res) {
+  auto head_site = sites_set[sorted_evt_idxs[0]][0];
+  auto temp_ten = CtrctHeadTen(mps, head_site, phys_ops[0]);
+  auto site = head_site + 1;
+  for (auto evt_idx : sorted_evt_idxs) {
+    auto &sites = sites_set[evt_idx];
+    assert(sites[0] == head_site);
+    for (; site < sites[1]; ++site) {
+      CtrctMidTen(mps, site, inst_op, id_op, temp_ten);
+    }
+    auto res_ten = CtrctTailTen(mps, sites[1], phys_ops[1], *temp_ten);
+    measu_res[evt_idx] = MeasuResElem<TenElemType>(sites, res_ten->scalar);
+    delete res_ten;
+  }
+  delete temp_ten;
+}
+
+
+template <typename TenType>
+TenType *CtrctHeadTen(
+    const MPS<TenType> &mps, const long site, const TenType &op) {
+  std::vector<long> head_mps_ten_ctrct_axes1;
+  std::vector<long> head_mps_ten_ctrct_axes2;
+  std::vector<long> head_mps_ten_ctrct_axes3;
+  if (site == 0) {
+    head_mps_ten_ctrct_axes1 = {0};
+    head_mps_ten_ctrct_axes2 = {1};
+    head_mps_ten_ctrct_axes3 = {0};
+  } else {
+    head_mps_ten_ctrct_axes1 = {1};
+    head_mps_ten_ctrct_axes2 = {0, 2};
+    head_mps_ten_ctrct_axes3 = {0, 1};
+  }
+  auto temp_ten = Contract(
+                      *mps.tens[site], op,
+                      {head_mps_ten_ctrct_axes1, {0}});
+  auto t = Contract(
+               *temp_ten, Dag(*mps.tens[site]),
+               {head_mps_ten_ctrct_axes2, head_mps_ten_ctrct_axes3});
+  delete temp_ten;
+  return t;
+}
+
+
 template <typename TenType>
 void CtrctMidTen(
     const MPS<TenType> &mps, const long site,
@@ -292,6 +663,31 @@ void CtrctMidTen(
 }
 
 
+// Close the transfer tensor at the tail site. The transfer tensor is kept.
+template <typename TenType>
+TenType *CtrctTailTen(
+    const MPS<TenType> &mps, const long site,
+    const TenType &op, const TenType &t) {
+  std::vector<long> tail_mps_ten_ctrct_axes1;
+  std::vector<long> tail_mps_ten_ctrct_axes2;
+  if (site == (long)mps.N-1) {
+    tail_mps_ten_ctrct_axes1 = {0, 1}; 
+    tail_mps_ten_ctrct_axes2 = {0, 1};
+  } else {
+    tail_mps_ten_ctrct_axes1 = {0, 1, 2};
+    tail_mps_ten_ctrct_axes2 = {2, 0, 1};
+  }
+  auto temp_ten1 = Contract(*mps.tens[site], t, {{0}, {0}});
+  auto temp_ten2 = Contract(*temp_ten1, op, {{0}, {0}});
+  delete temp_ten1;
+  auto res_ten = Contract(
+                     *temp_ten2, Dag(*mps.tens[site]),
+                     {tail_mps_ten_ctrct_axes1, tail_mps_ten_ctrct_axes2});
+  delete temp_ten2;
+  return res_ten;
+}
+
+
 // Date dump.
 template <typename AvgType>
 void DumpMeasuRes(
@@ -319,4 +715,115 @@ void DumpMeasuRes(
 
   ofs.close();
 }
-} /* gqmps2 */ 
+
+
+// Measurement result writer.
+template <typename AvgType>
+MeasuResWriter<AvgType>::MeasuResWriter(
+    const std::string &basename, const char format) :
+    basename_(basename), format_(format) {
+  switch (format_) {
+    case kMeasuResFileFormatJson:
+      break;
+    case kMeasuResFileFormatBinary: {
+      ofs_.open(basename_ + "." + kMeasuResBinFileSuffix, std::ofstream::binary);
+      std::uint32_t version = kMeasuResBinFileVersion;
+      std::uint32_t avg_size = sizeof(AvgType) / sizeof(double);
+      ofs_.write(kMeasuResBinFileMagic, 4);
+      ofs_.write(reinterpret_cast<const char *>(&version), sizeof(version));
+      ofs_.write(reinterpret_cast<const char *>(&avg_size), sizeof(avg_size));
+      break;
+    }
+    default:
+      std::cout << "Unsupported measurement result file format " << format_
+                << std::endl;
+      exit(1);
+  }
+}
+
+
+template <typename AvgType>
+MeasuResWriter<AvgType>::~MeasuResWriter(void) {
+  if (ofs_.is_open()) { ofs_.close(); }
+}
+
+
+// Thread safe. The JSON format keeps nothing here and is dumped by Close.
+template <typename AvgType>
+void MeasuResWriter<AvgType>::Write(
+    const std::size_t evt_idx, const MeasuResElem<AvgType> &measu_res_elem) {
+  if (format_ != kMeasuResFileFormatBinary) { return; }
+  std::uint64_t idx = evt_idx;
+  std::uint32_t site_num = measu_res_elem.sites.size();
+  std::vector<std::int64_t> sites(
+                                measu_res_elem.sites.begin(),
+                                measu_res_elem.sites.end());
+  std::lock_guard<std::mutex> lock(mtx_);
+  ofs_.write(reinterpret_cast<const char *>(&idx), sizeof(idx));
+  ofs_.write(reinterpret_cast<const char *>(&site_num), sizeof(site_num));
+  ofs_.write(
+      reinterpret_cast<const char *>(sites.data()),
+      site_num * sizeof(std::int64_t));
+  ofs_.write(
+      reinterpret_cast<const char *>(&measu_res_elem.avg), sizeof(AvgType));
+}
+
+
+template <typename AvgType>
+void MeasuResWriter<AvgType>::Close(const MeasuRes<AvgType> &res) {
+  if (format_ == kMeasuResFileFormatJson) {
+    DumpMeasuRes(res, basename_);
+  } else {
+    ofs_.close();
+  }
+}
+
+
+template <typename AvgType>
+std::vector<MeasuResWriter<AvgType> *> GenMeasuResWriters(
+    const std::vector<std::string> &basenames, const char format) {
+  std::vector<MeasuResWriter<AvgType> *> writers;
+  for (auto &basename : basenames) {
+    writers.push_back(new MeasuResWriter<AvgType>(basename, format));
+  }
+  return writers;
+}
+
+
+// The records are put back to the order of the events.
+template <typename AvgType>
+MeasuRes<AvgType> LoadMeasuRes(const std::string &basename) {
+  auto file = basename + "." + kMeasuResBinFileSuffix;
+  std::ifstream ifs(file, std::ifstream::binary);
+  char magic[4];
+  std::uint32_t version, avg_size;
+  ifs.read(magic, 4);
+  ifs.read(reinterpret_cast<char *>(&version), sizeof(version));
+  ifs.read(reinterpret_cast<char *>(&avg_size), sizeof(avg_size));
+  if (
+      !ifs ||
+      std::string(magic, 4) != std::string(kMeasuResBinFileMagic, 4) ||
+      version != kMeasuResBinFileVersion ||
+      avg_size != sizeof(AvgType) / sizeof(double)) {
+    std::cout << "Invalid measurement result file " << file << std::endl;
+    exit(1);
+  }
+
+  MeasuRes<AvgType> res;
+  std::uint64_t idx;
+  std::uint32_t site_num;
+  while (ifs.read(reinterpret_cast<char *>(&idx), sizeof(idx))) {
+    ifs.read(reinterpret_cast<char *>(&site_num), sizeof(site_num));
+    std::vector<std::int64_t> sites(site_num);
+    ifs.read(
+        reinterpret_cast<char *>(sites.data()),
+        site_num * sizeof(std::int64_t));
+    AvgType avg;
+    ifs.read(reinterpret_cast<char *>(&avg), sizeof(AvgType));
+    if (idx >= res.size()) { res.resize(idx+1); }
+    res[idx] = MeasuResElem<AvgType>(
+                   std::vector<long>(sites.begin(), sites.end()), avg);
+  }
+  return res;
+}
+} /* gqmps2 */
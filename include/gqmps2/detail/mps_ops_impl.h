@@ -8,8 +8,12 @@
 #include "gqmps2/gqmps2.h"
 #include "gqten/gqten.h"
 
+#include <iostream>
+#include <vector>
+#include <string>
 #include <algorithm>
 #include <cmath>
+#include <numeric>
 
 #include <assert.h>
 
@@ -35,18 +39,95 @@ Index GenBodyLeftVirtBond(const Index &, const Index &, const QN &, const long);
 
 void DimCut(std::vector<QNSector> &, const long, const long);
 
+// For MPS enlargement.
+std::vector<QNSector> GenReachedBondQnScts(
+    const std::vector<QNSector> &, const Index &, const QN &, const bool,
+    const long);
+
+std::vector<QNSector> GrowBondQnScts(
+    const std::vector<QNSector> &, std::vector<QNSector>, const long);
+
+template <typename TenType>
+TenType *GenBondEmbedding(const Index &, const Index &);
+
 // For MPS centralization.
+// The QR decompositions run over the quantum number blocks on thread_num
+// threads.
 template <typename MpsType>
-void LeftNormalizeMps(MpsType &, const long, const long);
+void LeftNormalizeMps(
+    MpsType &, const long, const long, const unsigned thread_num = 1);
 
 template <typename MpsType>
-void LeftNormalizeMpsTen(MpsType &, const long);
+void LeftNormalizeMpsTen(MpsType &, const long, const unsigned thread_num = 1);
 
 template <typename MpsType>
-void RightNormalizeMps(MpsType &, const long, const long);
+void RightNormalizeMps(
+    MpsType &, const long, const long, const unsigned thread_num = 1);
 
 template <typename MpsType>
-void RightNormalizeMpsTen(MpsType &, const long);
+void RightNormalizeMpsTen(MpsType &, const long, const unsigned thread_num = 1);
+
+// For MPS compression.
+template <typename TenType>
+void TruncRightNormalizeMpsTen(
+    std::vector<TenType *> &, const long, const MpsCompressParams &);
+
+template <typename TenType>
+TenType *GenMpsOverlapTen(
+    const std::vector<TenType *> &, const std::vector<TenType *> &);
+
+template <typename TenType>
+TenType *GenMpsMpoOverlapTen(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const std::vector<TenType *> &);
+
+template <typename TenType>
+TenType *GenMpoMpsNormSquareTen(
+    const std::vector<TenType *> &, const std::vector<TenType *> &);
+
+template <typename TenType>
+double MpsFitFidelity(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const std::vector<TenType *> &);
+
+template <typename TenType>
+void ZipUpMpoMps(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    std::vector<TenType *> &, const MpsCompressParams &);
+
+template <typename TenType>
+void FitMps(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    std::vector<TenType *> &,
+    const MpsCompressParams &);
+
+template <typename TenType>
+TenType *GenLeftFitEnv(
+    const TenType *,
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const long);
+
+template <typename TenType>
+TenType *GenRightFitEnv(
+    const TenType *,
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const long);
+
+template <typename TenType>
+TenType *GenFitProjTen(
+    const TenType *, const TenType *,
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const long, const long);
+
+template <typename TenType>
+void FitMpsUpdate(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    std::vector<TenType *> &,
+    const TenType *, const TenType *,
+    const long, const long, const char,
+    const MpsCompressParams &);
 
 
 // Helpers
@@ -350,21 +431,221 @@ void ExtendDirectRandomInitMps(
 }
 
 
-// MPS centralization.
+// MPS enlargement.
+template <typename TenType>
+void EnlargeMps(
+    std::vector<TenType *> &mps, const long dmax,
+    const double noise, const unsigned thread_num) {
+  auto N = mps.size();
+  assert(N >= 2);
+  std::vector<QN> divs;
+  std::vector<Index> pbs;
+  for (std::size_t i = 0; i < N; ++i) {
+    divs.push_back(Div(*mps[i]));
+    if (i == 0) {
+      pbs.push_back(mps[i]->indexes[0]);
+    } else {
+      pbs.push_back(mps[i]->indexes[1]);
+    }
+  }
+  auto zero_qn = divs[0] - divs[0];
+  std::vector<QNSector> end_qnscts = {QNSector(zero_qn, 1)};
+
+  // Sectors of each bond reachable from the right end.
+  std::vector<std::vector<QNSector>> rcaps(N-1);
+  rcaps[N-2] = GenReachedBondQnScts(
+                   end_qnscts, pbs[N-1], divs[N-1], false, dmax);
+  for (long b = N-3; b >= 0; --b) {
+    rcaps[b] = GenReachedBondQnScts(
+                   rcaps[b+1], pbs[b+1], divs[b+1], false, dmax);
+  }
+
+  // Grow each bond within the sectors reachable from the enlarged bond on its
+  // left and from the right end.
+  std::vector<std::vector<QNSector>> new_qnscts(N-1);
+  for (std::size_t b = 0; b < N-1; ++b) {
+    auto lcaps = GenReachedBondQnScts(
+                     b == 0 ? end_qnscts : new_qnscts[b-1],
+                     pbs[b], divs[b], true, dmax);
+    std::vector<QNSector> avail_qnscts;
+    for (auto &lcap : lcaps) {
+      for (auto &rcap : rcaps[b]) {
+        if (rcap.qn == lcap.qn) {
+          avail_qnscts.push_back(
+              QNSector(lcap.qn, std::min(lcap.dim, rcap.dim)));
+          break;
+        }
+      }
+    }
+    new_qnscts[b] = GrowBondQnScts(
+                        mps[b]->indexes.back().qnscts, avail_qnscts, dmax);
+  }
+
+  // Cut the states which the enlarged bond on the right can not hold.
+  for (long b = N-2; b >= 0; --b) {
+    auto caps = GenReachedBondQnScts(
+                    b == (long)N-2 ? end_qnscts : new_qnscts[b+1],
+                    pbs[b+1], divs[b+1], false, dmax);
+    for (auto &qnsct : new_qnscts[b]) {
+      long cap = 0;
+      for (auto &c : caps) {
+        if (c.qn == qnsct.qn) { cap = c.dim; break; }
+      }
+      long old_dim = 0;
+      for (auto &old_qnsct : mps[b]->indexes.back().qnscts) {
+        if (old_qnsct.qn == qnsct.qn) { old_dim = old_qnsct.dim; break; }
+      }
+      qnsct.dim = std::max(std::min(qnsct.dim, cap), old_dim);
+    }
+    new_qnscts[b].erase(
+        std::remove_if(
+            new_qnscts[b].begin(), new_qnscts[b].end(),
+            [](const QNSector &qnsct) { return qnsct.dim == 0; }),
+        new_qnscts[b].end());
+  }
+
+  // Embed the sites into the enlarged bonds.
+  std::vector<TenType *> embs(N-1);
+  for (std::size_t b = 0; b < N-1; ++b) {
+    embs[b] = GenBondEmbedding<TenType>(
+                  mps[b]->indexes.back(), Index(new_qnscts[b], OUT));
+  }
+  for (std::size_t i = 0; i < N; ++i) {
+    if (i > 0) {
+      auto ten = Contract(Dag(*embs[i-1]), *mps[i], {{0}, {0}});
+      delete mps[i];
+      mps[i] = ten;
+    }
+    if (i < N-1) {
+      long r = mps[i]->indexes.size() - 1;
+      auto ten = Contract(*mps[i], *embs[i], {{r}, {0}});
+      delete mps[i];
+      mps[i] = ten;
+    }
+    if (noise > 0) {
+      TenType rand_ten(mps[i]->indexes);
+      rand_ten.Random(divs[i]);
+      rand_ten.Normalize();
+      LinearCombine({noise}, {&rand_ten}, mps[i]);
+    }
+  }
+  for (auto &emb : embs) { delete emb; }
+
+  // Centralize MPS.
+  auto temp_mps = MPS<TenType>(mps, -1);
+  RightNormalizeMps(temp_mps, temp_mps.N-1, 1, thread_num);
+}
+
+
+// Sectors of the bond on the other side of the site reached from the sectors
+// of the bond on its left (from_left) or right, each one capped at dmax states.
+inline std::vector<QNSector> GenReachedBondQnScts(
+    const std::vector<QNSector> &bond_qnscts,
+    const Index &pb, const QN &div, const bool from_left, const long dmax) {
+  std::vector<QNSector> new_qnscts;
+  for (auto &bqnsct : bond_qnscts) {
+    for (auto &pqnsct : pb.qnscts) {
+      auto new_qn = from_left ?
+                    div + bqnsct.qn - pqnsct.qn :
+                    pqnsct.qn - div + bqnsct.qn;
+      auto new_dim = bqnsct.dim * pqnsct.dim;
+      auto has_qn = false;
+      for (auto &new_qnsct : new_qnscts) {
+        if (new_qnsct.qn == new_qn) {
+          new_qnsct.dim = std::min(new_qnsct.dim + new_dim, dmax);
+          has_qn = true;
+          break;
+        }
+      }
+      if (!has_qn) {
+        new_qnscts.push_back(QNSector(new_qn, std::min(new_dim, dmax)));
+      }
+    }
+  }
+  return new_qnscts;
+}
+
+
+// Grow the old sectors one state per round over the available sectors, the
+// largest ones first, until the bond has dmax states.
+inline std::vector<QNSector> GrowBondQnScts(
+    const std::vector<QNSector> &old_qnscts,
+    std::vector<QNSector> avail_qnscts, const long dmax) {
+  auto new_qnscts = old_qnscts;
+  long dim = 0;
+  for (auto &qnsct : new_qnscts) { dim += qnsct.dim; }
+  std::sort(avail_qnscts.begin(), avail_qnscts.end(), GreaterQNSectorDim);
+  for (auto &avail_qnsct : avail_qnscts) {
+    auto has_qn = false;
+    for (auto &new_qnsct : new_qnscts) {
+      if (new_qnsct.qn == avail_qnsct.qn) { has_qn = true; break; }
+    }
+    if (!has_qn) { new_qnscts.push_back(QNSector(avail_qnsct.qn, 0)); }
+  }
+
+  auto grown = true;
+  while (dim < dmax && grown) {
+    grown = false;
+    for (auto &avail_qnsct : avail_qnscts) {
+      if (dim == dmax) { break; }
+      for (auto &new_qnsct : new_qnscts) {
+        if (new_qnsct.qn == avail_qnsct.qn) {
+          if (new_qnsct.dim < avail_qnsct.dim) {
+            new_qnsct.dim++;
+            dim++;
+            grown = true;
+          }
+          break;
+        }
+      }
+    }
+  }
+  return new_qnscts;
+}
+
+
+// Embedding (old_bond^dag, new_bond) which maps the old states to the first
+// ones of the sectors of the enlarged bond with the same quantum numbers.
+template <typename TenType>
+TenType *GenBondEmbedding(const Index &old_bond, const Index &new_bond) {
+  auto emb = new TenType({InverseIndex(old_bond), new_bond});
+  long old_offset = 0;
+  for (auto &old_qnsct : old_bond.qnscts) {
+    long new_offset = 0;
+    for (auto &new_qnsct : new_bond.qnscts) {
+      if (new_qnsct.qn == old_qnsct.qn) { break; }
+      new_offset += new_qnsct.dim;
+    }
+    for (long k = 0; k < old_qnsct.dim; ++k) {
+      (*emb)({old_offset+k, new_offset+k}) = 1;
+    }
+    old_offset += old_qnsct.dim;
+  }
+  return emb;
+}
+
+
+// MPS centralization by QR decompositions, which run over the quantum number
+// blocks on thread_num threads.
 template <typename MpsType>
-void CentralizeMps(MpsType &mps, const long target_center) {
+void CentralizeMps(
+    MpsType &mps, const long target_center, const unsigned thread_num = 1) {
   auto origin_center = mps.center;
   if (origin_center < 0) {
-    auto end = mps.N-1;
-    if (target_center != 0) { LeftNormalizeMps(mps, 0, target_center-1); }
-    if (target_center != end) { RightNormalizeMps(mps, end, target_center+1); }
+    long end = mps.N-1;
+    if (target_center != 0) {
+      LeftNormalizeMps(mps, 0, target_center-1, thread_num);
+    }
+    if (target_center != end) {
+      RightNormalizeMps(mps, end, target_center+1, thread_num);
+    }
     mps.center = target_center;
   } else {
     if (target_center > origin_center) {
-      LeftNormalizeMps(mps, origin_center, target_center-1);
+      LeftNormalizeMps(mps, origin_center, target_center-1, thread_num);
       mps.center = target_center;
     } else if (target_center < origin_center) {
-      RightNormalizeMps(mps, origin_center, target_center+1);
+      RightNormalizeMps(mps, origin_center, target_center+1, thread_num);
       mps.center = target_center;
     }
   }
@@ -372,25 +653,28 @@ void CentralizeMps(MpsType &mps, const long target_center) {
 
 
 template <typename MpsType>
-void LeftNormalizeMps(MpsType &mps, const long from, const long to) {
+void LeftNormalizeMps(
+    MpsType &mps, const long from, const long to, const unsigned thread_num) {
   assert(to >= from);
   for (long i = from; i <= to; ++i) {
-    LeftNormalizeMpsTen(mps, i);
+    LeftNormalizeMpsTen(mps, i, thread_num);
   }
 }
 
 
 template <typename MpsType>
-void RightNormalizeMps(MpsType &mps, const long from, const long to) {
+void RightNormalizeMps(
+    MpsType &mps, const long from, const long to, const unsigned thread_num) {
   assert(to <= from);
   for (long i = from; i >= to; --i) {
-    RightNormalizeMpsTen(mps, i);
+    RightNormalizeMpsTen(mps, i, thread_num);
   }
 }
 
 
 template <typename MpsType>
-void LeftNormalizeMpsTen(MpsType &mps, const long site) {
+void LeftNormalizeMpsTen(
+    MpsType &mps, const long site, const unsigned thread_num) {
   assert(site < mps.N-1);
   long ldims, rdims;
   if (site == 0) {
@@ -400,15 +684,15 @@ void LeftNormalizeMpsTen(MpsType &mps, const long site) {
     ldims = 2;
     rdims = 1;
   }
-  auto svd_res = Svd(
+  auto qr_res = BlockQr(
       *mps.tens[site],
       ldims, rdims,
-      Div(*mps.tens[site]), Div(*mps.tens[site+1]));
+      Div(*mps.tens[site+1]),
+      false,
+      thread_num);
   delete mps.tens[site];
-  mps.tens[site] = svd_res.u;
-  auto temp_ten = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
-  delete svd_res.s;
-  delete svd_res.v;
+  mps.tens[site] = qr_res.first;
+  auto temp_ten = qr_res.second;
   auto next_ten = Contract(*temp_ten, *mps.tens[site+1], {{1}, {0}});
   delete temp_ten;
   delete mps.tens[site+1];
@@ -417,7 +701,8 @@ void LeftNormalizeMpsTen(MpsType &mps, const long site) {
 
 
 template <typename MpsType>
-void RightNormalizeMpsTen(MpsType &mps, const long site) {
+void RightNormalizeMpsTen(
+    MpsType &mps, const long site, const unsigned thread_num) {
   assert(site > 0);
   long ldims, rdims;
   if (site == mps.N-1) {
@@ -427,15 +712,15 @@ void RightNormalizeMpsTen(MpsType &mps, const long site) {
     ldims = 1;
     rdims = 2;
   }
-  auto svd_res = Svd(
+  auto lq_res = BlockQr(
       *mps.tens[site],
       ldims, rdims,
-      Div(*mps.tens[site-1]), Div(*mps.tens[site]));
+      Div(*mps.tens[site]),
+      true,
+      thread_num);
   delete mps.tens[site];
-  mps.tens[site] = svd_res.v;
-  auto temp_ten = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
-  delete svd_res.u;
-  delete svd_res.s;
+  mps.tens[site] = lq_res.second;
+  auto temp_ten = lq_res.first;
   std::vector<long> ta_ctrct_axes;
   if ((site-1) == 0) {
     ta_ctrct_axes = {1};
@@ -447,4 +732,426 @@ void RightNormalizeMpsTen(MpsType &mps, const long site) {
   delete mps.tens[site-1];
   mps.tens[site-1] = prev_ten;
 }
+
+
+// MPS compression.
+template <typename TenType>
+double CompressMps(
+    const std::vector<TenType *> &mps,
+    std::vector<TenType *> &compressed_mps,
+    const MpsCompressParams &params) {
+  long N = mps.size();
+  assert(N >= 2);
+  assert((long)compressed_mps.size() == N);
+  for (long i = 0; i < N; ++i) { compressed_mps[i] = new TenType(*mps[i]); }
+  auto temp_mps = MPS<TenType>(compressed_mps, -1);
+  CentralizeMps(temp_mps, N-1);
+  for (long i = N-1; i > 0; --i) {
+    TruncRightNormalizeMpsTen(compressed_mps, i, params);
+  }
+  std::vector<TenType *> no_mpo;
+  switch (params.Method) {
+    case kMpsCompressSvd:
+      break;
+    case kMpsCompressOneSite:
+    case kMpsCompressTwoSite:
+      FitMps(mps, no_mpo, compressed_mps, params);
+      break;
+    default:
+      std::cout << "Unknown MPS compression method " << params.Method
+                << std::endl;
+      exit(1);
+  }
+  return MpsFitFidelity(mps, no_mpo, compressed_mps);
+}
+
+
+// Compression of mpo applied to mps. The start is zipped up from the left and
+// truncated again by a canonical SVD sweep from the right, the variational
+// fittings then sweep with the environments of <compressed_mps|mpo|mps>.
+template <typename TenType>
+double CompressMps(
+    const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &mps,
+    std::vector<TenType *> &compressed_mps,
+    const MpsCompressParams &params) {
+  long N = mps.size();
+  assert(N >= 2);
+  assert((long)mpo.size() == N);
+  assert((long)compressed_mps.size() == N);
+  ZipUpMpoMps(mpo, mps, compressed_mps, params);
+  for (long i = N-1; i > 0; --i) {
+    TruncRightNormalizeMpsTen(compressed_mps, i, params);
+  }
+  switch (params.Method) {
+    case kMpsCompressSvd:
+      break;
+    case kMpsCompressOneSite:
+    case kMpsCompressTwoSite:
+      FitMps(mps, mpo, compressed_mps, params);
+      break;
+    default:
+      std::cout << "Unknown MPS compression method " << params.Method
+                << std::endl;
+      exit(1);
+  }
+  return MpsFitFidelity(mps, mpo, compressed_mps);
+}
+
+
+// |<compressed_mps|mps>| / ||mps||, or |<compressed_mps|mpo|mps>| /
+// ||mpo|mps>|| if mpo is not empty.
+template <typename TenType>
+double MpsFitFidelity(
+    const std::vector<TenType *> &mps,
+    const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &compressed_mps) {
+  TenType *overlap_ten, *norm_ten;
+  if (mpo.empty()) {
+    overlap_ten = GenMpsOverlapTen(compressed_mps, mps);
+    norm_ten = GenMpsOverlapTen(mps, mps);
+  } else {
+    overlap_ten = GenMpsMpoOverlapTen(compressed_mps, mpo, mps);
+    norm_ten = GenMpoMpsNormSquareTen(mpo, mps);
+  }
+  auto fidelity = std::abs(overlap_ten->scalar) /
+                  std::sqrt(std::abs(norm_ten->scalar));
+  delete overlap_ten;
+  delete norm_ten;
+  return fidelity;
+}
+
+
+// Apply mpo to mps site by site from the left. The product tensor of a site
+// and the rest carried from the left is truncated by the SVD, whose u is the
+// site of the result, so the result is left canonical and its bonds never
+// grow to the products of the bonds of mps and mpo. The carried bonds of mps
+// and mpo are not orthonormal, so the truncation keeps kMpsZipUpDmaxFactor
+// times Dmax and leaves the rest to the canonical sweep after it.
+template <typename TenType>
+void ZipUpMpoMps(
+    const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &mps,
+    std::vector<TenType *> &res_mps,
+    const MpsCompressParams &params) {
+  long N = mps.size();
+  TenType *carry = nullptr;
+  for (long i = 0; i < N; ++i) {
+    TenType *prod;
+    if (i == 0) {
+      // The legs are (physical, mps bond, mpo bond).
+      prod = Contract(*mps[0], *mpo[0], {{0}, {0}});
+      prod->Transpose({2, 0, 1});
+    } else {
+      prod = Contract(*carry, *mps[i], {{1}, {0}});
+      delete carry;
+      if (i == N-1) {
+        InplaceContract(prod, *mpo[i], {{1, 2}, {1, 0}});
+        res_mps[i] = prod;
+        return;
+      }
+      // The legs are (bond, physical, mps bond, mpo bond).
+      InplaceContract(prod, *mpo[i], {{1, 2}, {0, 1}});
+      prod->Transpose({0, 2, 1, 3});
+    }
+    long ldims = (i == 0) ? 1 : 2;
+    auto ldiv = Div(*mps[i]) + Div(*mpo[i]);
+    auto svd_res = Svd(
+        *prod,
+        ldims, 2,
+        ldiv, Div(*prod) - ldiv,
+        params.Cutoff,
+        params.Dmin, kMpsZipUpDmaxFactor * params.Dmax);
+    delete prod;
+    res_mps[i] = svd_res.u;
+    carry = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    delete svd_res.s;
+    delete svd_res.v;
+  }
+}
+
+
+// Truncate the bond on the left of the site, which becomes right normalized.
+// The kept singular values are normalized.
+template <typename TenType>
+void TruncRightNormalizeMpsTen(
+    std::vector<TenType *> &mps, const long site,
+    const MpsCompressParams &params) {
+  assert(site > 0);
+  long N = mps.size();
+  long rdims = (site == N-1) ? 1 : 2;
+  auto svd_res = Svd(
+      *mps[site],
+      1, rdims,
+      Div(*mps[site-1]), Div(*mps[site]),
+      params.Cutoff,
+      params.Dmin, params.Dmax);
+  delete mps[site];
+  mps[site] = svd_res.v;
+  auto temp_ten = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+  delete svd_res.u;
+  delete svd_res.s;
+  std::vector<long> ta_ctrct_axes;
+  if ((site-1) == 0) {
+    ta_ctrct_axes = {1};
+  } else {
+    ta_ctrct_axes = {2};
+  }
+  auto prev_ten = Contract(*mps[site-1], *temp_ten, {ta_ctrct_axes, {0}});
+  delete temp_ten;
+  delete mps[site-1];
+  mps[site-1] = prev_ten;
+}
+
+
+// <bra_mps|ket_mps> as a scalar tensor.
+template <typename TenType>
+TenType *GenMpsOverlapTen(
+    const std::vector<TenType *> &bra_mps,
+    const std::vector<TenType *> &ket_mps) {
+  TenType *env = nullptr;
+  for (std::size_t i = 0; i < ket_mps.size(); ++i) {
+    auto new_env = GenLeftOverlapEnv(env, *ket_mps[i], *bra_mps[i], i);
+    delete env;
+    env = new_env;
+  }
+  return env;
+}
+
+
+// <bra_mps|mpo|ket_mps> as a scalar tensor.
+template <typename TenType>
+TenType *GenMpsMpoOverlapTen(
+    const std::vector<TenType *> &bra_mps,
+    const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &ket_mps) {
+  long N = ket_mps.size();
+  TenType *lenv = nullptr;
+  for (long i = 0; i < N-1; ++i) {
+    auto new_lenv = GenLeftMpoOverlapEnv(
+                        lenv, *ket_mps[i], *mpo[i], *bra_mps[i], i);
+    delete lenv;
+    lenv = new_lenv;
+  }
+  TenType *renv0 = nullptr;
+  auto renv = GenRightMpoOverlapEnv(
+                  renv0, *ket_mps[N-1], *mpo[N-1], *bra_mps[N-1], N-1, N);
+  auto overlap_ten = Contract(*lenv, *renv, {{0, 1, 2}, {0, 1, 2}});
+  delete lenv;
+  delete renv;
+  return overlap_ten;
+}
+
+
+// <mps|mpo^dag mpo|mps> as a scalar tensor. The legs of the environment are
+// (ket, mpo, mpo^dag, bra).
+template <typename TenType>
+TenType *GenMpoMpsNormSquareTen(
+    const std::vector<TenType *> &mpo, const std::vector<TenType *> &mps) {
+  long N = mps.size();
+  auto env = Contract(*mps[0], *mpo[0], {{0}, {0}});
+  InplaceContract(env, Dag(*mpo[0]), {{2}, {2}});
+  InplaceContract(env, Dag(*mps[0]), {{2}, {0}});
+  for (long i = 1; i < N-1; ++i) {
+    InplaceContract(env, *mps[i], {{0}, {0}});
+    InplaceContract(env, *mpo[i], {{0, 3}, {0, 1}});
+    InplaceContract(env, Dag(*mpo[i]), {{0, 3}, {0, 2}});
+    InplaceContract(env, Dag(*mps[i]), {{0, 3}, {0, 1}});
+  }
+  InplaceContract(env, *mps[N-1], {{0}, {0}});
+  InplaceContract(env, *mpo[N-1], {{0, 3}, {1, 0}});
+  InplaceContract(env, Dag(*mpo[N-1]), {{0, 2}, {1, 2}});
+  InplaceContract(env, Dag(*mps[N-1]), {{0, 1}, {0, 1}});
+  return env;
+}
+
+
+// Variational sweeps of the right canonical compressed MPS towards mps, or
+// towards mpo applied to mps if mpo is not empty. An update of the sites from
+// i replaces them by the projection of the target, which is the closest state
+// as the other sites are canonical, truncated by the SVD for the two-site
+// fitting or normalized and decomposed by QR or LQ for the one-site fitting.
+// lenvs[l] and renvs[l] are the environments of the l sites at the ends.
+template <typename TenType>
+void FitMps(
+    const std::vector<TenType *> &mps,
+    const std::vector<TenType *> &mpo,
+    std::vector<TenType *> &compressed_mps,
+    const MpsCompressParams &params) {
+  long N = mps.size();
+  auto &cmps = compressed_mps;
+  long w = (params.Method == kMpsCompressTwoSite) ? 2 : 1;
+  assert(N > w);
+  std::vector<TenType *> lenvs(N, nullptr), renvs(N, nullptr);
+  for (long l = 1; l <= N-w; ++l) {
+    renvs[l] = GenRightFitEnv(renvs[l-1], mps, mpo, cmps, N-l);
+  }
+  for (long sweep = 0; sweep < params.Sweeps; ++sweep) {
+    for (long i = 0; i <= N-w; ++i) {
+      FitMpsUpdate(mps, mpo, cmps, lenvs[i], renvs[N-i-w], i, w, 'r', params);
+      if (i < N-w) {
+        delete lenvs[i+1];
+        lenvs[i+1] = GenLeftFitEnv(lenvs[i], mps, mpo, cmps, i);
+      }
+    }
+    for (long i = N-w; i >= 0; --i) {
+      FitMpsUpdate(mps, mpo, cmps, lenvs[i], renvs[N-i-w], i, w, 'l', params);
+      if (i > 0) {
+        auto site = i+w-1;
+        delete renvs[N-site];
+        renvs[N-site] = GenRightFitEnv(renvs[N-site-1], mps, mpo, cmps, site);
+      }
+    }
+  }
+  for (auto &env : lenvs) { delete env; }
+  for (auto &env : renvs) { delete env; }
+}
+
+
+// Grow the left environment of the fitting, which ends at site-1, to site.
+template <typename TenType>
+TenType *GenLeftFitEnv(
+    const TenType *lenv,
+    const std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &cmps,
+    const long site) {
+  if (mpo.empty()) {
+    return GenLeftOverlapEnv(lenv, *mps[site], *cmps[site], site);
+  }
+  return GenLeftMpoOverlapEnv(lenv, *mps[site], *mpo[site], *cmps[site], site);
+}
+
+
+// Grow the right environment of the fitting, which starts at site+1, to site.
+template <typename TenType>
+TenType *GenRightFitEnv(
+    const TenType *renv,
+    const std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &cmps,
+    const long site) {
+  long N = mps.size();
+  if (mpo.empty()) {
+    return GenRightOverlapEnv(renv, *mps[site], *cmps[site], site, N);
+  }
+  return GenRightMpoOverlapEnv(
+             renv, *mps[site], *mpo[site], *cmps[site], site, N);
+}
+
+
+// The projection of the target on the w sites from i, shaped like the sites
+// of the compressed MPS.
+template <typename TenType>
+TenType *GenFitProjTen(
+    const TenType *lenv, const TenType *renv,
+    const std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const long i, const long w) {
+  long N = mps.size();
+  if (mpo.empty()) {
+    if (w == 2) {
+      std::string where = "cent";
+      if (i == 0) {
+        where = "lend";
+      } else if (i == N-2) {
+        where = "rend";
+      }
+      return GenTwoSiteProjState(lenv, *mps[i], *mps[i+1], renv, where);
+    }
+    TenType *proj_ten;
+    if (i == 0) {
+      proj_ten = Contract(*mps[0], *renv, {{1}, {0}});
+    } else if (i == N-1) {
+      proj_ten = Contract(*lenv, *mps[N-1], {{0}, {0}});
+    } else {
+      proj_ten = Contract(*lenv, *mps[i], {{0}, {0}});
+      InplaceContract(proj_ten, *renv, {{2}, {0}});
+    }
+    return proj_ten;
+  }
+
+  // The legs are kept as (open legs, mps bond, mpo bond) while the sites are
+  // added.
+  TenType *proj_ten;
+  if (i == 0) {
+    proj_ten = Contract(*mps[0], *mpo[0], {{0}, {0}});
+    proj_ten->Transpose({2, 0, 1});
+  } else {
+    proj_ten = Contract(*lenv, *mps[i], {{0}, {0}});
+    if (i == N-1) {
+      InplaceContract(proj_ten, *mpo[i], {{0, 2}, {1, 0}});
+      return proj_ten;
+    }
+    InplaceContract(proj_ten, *mpo[i], {{0, 2}, {0, 1}});
+    proj_ten->Transpose({0, 2, 1, 3});
+  }
+  for (long j = i+1; j < i+w; ++j) {
+    long rank = proj_ten->indexes.size();
+    InplaceContract(proj_ten, *mps[j], {{rank-2}, {0}});
+    if (j == N-1) {
+      InplaceContract(proj_ten, *mpo[j], {{rank-2, rank-1}, {1, 0}});
+      return proj_ten;
+    }
+    InplaceContract(proj_ten, *mpo[j], {{rank-2, rank-1}, {0, 1}});
+    std::vector<long> axes(rank+1);
+    std::iota(axes.begin(), axes.end(), 0);
+    std::swap(axes[rank-2], axes[rank-1]);
+    proj_ten->Transpose(axes);
+  }
+  long rank = proj_ten->indexes.size();
+  InplaceContract(proj_ten, *renv, {{rank-2, rank-1}, {0, 1}});
+  return proj_ten;
+}
+
+
+template <typename TenType>
+void FitMpsUpdate(
+    const std::vector<TenType *> &mps,
+    const std::vector<TenType *> &mpo,
+    std::vector<TenType *> &cmps,
+    const TenType *lenv, const TenType *renv,
+    const long i, const long w, const char dir,
+    const MpsCompressParams &params) {
+  long N = mps.size();
+  long ldims = (i == 0) ? 1 : 2;
+  auto proj_ten = GenFitProjTen(lenv, renv, mps, mpo, i, w);
+  if (w == 2) {
+    long rdims = (i == N-2) ? 1 : 2;
+    auto svd_res = Svd(
+        *proj_ten,
+        ldims, rdims,
+        Div(*cmps[i]), Div(*cmps[i+1]),
+        params.Cutoff,
+        params.Dmin, params.Dmax);
+    delete proj_ten;
+    delete cmps[i];
+    delete cmps[i+1];
+    if (dir == 'r') {
+      cmps[i] = svd_res.u;
+      cmps[i+1] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      delete svd_res.v;
+    } else {
+      cmps[i] = Contract(*svd_res.u, *svd_res.s, {{ldims}, {0}});
+      cmps[i+1] = svd_res.v;
+      delete svd_res.u;
+    }
+    delete svd_res.s;
+    return;
+  }
+
+  proj_ten->Normalize();
+  delete cmps[i];
+  if (dir == 'r' && i < N-1) {
+    auto qr_res = BlockQr(*proj_ten, ldims, 1, Div(*cmps[i+1]), false, 1);
+    cmps[i] = qr_res.first;
+    delete qr_res.second;
+    delete proj_ten;
+  } else if (dir == 'l' && i > 0) {
+    long rdims = (i == N-1) ? 1 : 2;
+    auto lq_res = BlockQr(*proj_ten, 1, rdims, Div(*proj_ten), true, 1);
+    cmps[i] = lq_res.second;
+    delete lq_res.first;
+    delete proj_ten;
+  } else {
+    cmps[i] = proj_ten;
+  }
+}
 } /* gqmps2 */ 
@@ -0,0 +1,358 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 13:28
+* 
+* Description: GraceQ/MPS2 project. Implementation details for TDVP algorithm.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include <assert.h>
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Forward declarations.
+template <typename TenElemType>
+void TdvpSweep(
+    std::vector<GQTensor<TenElemType> *> &,
+    const std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    const TdvpParams &, const TenElemType);
+
+template <typename TenElemType>
+void TdvpOneSiteUpdate(
+    const long,
+    std::vector<GQTensor<TenElemType> *> &,
+    const std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    const TdvpParams &, const TenElemType, const char);
+
+template <typename TenElemType>
+void TdvpTwoSiteUpdate(
+    const long,
+    std::vector<GQTensor<TenElemType> *> &,
+    const std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    const TdvpParams &, const TenElemType, const char);
+
+
+// Helpers.
+inline void GenTdvpCoef(
+    const double tau, const bool real_time, GQTEN_Double &coef) {
+  if (real_time) {
+    std::cout << "Real time evolution needs complex tensors." << std::endl;
+    exit(1);
+  }
+  coef = -tau;
+}
+
+
+inline void GenTdvpCoef(
+    const double tau, const bool real_time, GQTEN_Complex &coef) {
+  if (real_time) {
+    coef = GQTEN_Complex(0, -tau);
+  } else {
+    coef = -tau;
+  }
+}
+
+
+// Replace the local state by exp(coef * H_eff) |state>. The state is kept
+// normalized for imaginary time evolution.
+template <typename TenElemType>
+void TdvpEvolve(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    GQTensor<TenElemType> * &state,
+    const TenElemType coef,
+    const TdvpParams &tdvp_params,
+    const std::string &where) {
+  auto lancz_exp_res = LanczosExpSolver(
+                           eff_ham, state, coef,
+                           tdvp_params.LanczParams,
+                           where);
+  state = lancz_exp_res.res_vec;
+  if (!tdvp_params.RealTime) { state->Normalize(); }
+}
+
+
+// TDVP algorithm.
+// Every step is a second order integration: a left to right sweep and a right
+// to left sweep, each evolving the state by half a time step. The blocks live
+// in memory and are indexed like the blocks of the two-site algorithm, with
+// the blocks which cover N-1 sites added for the one-site scheme.
+template <typename TenElemType>
+double TdvpAlgorithm(
+    std::vector<GQTensor<TenElemType> *> &mps,
+    const std::vector<GQTensor<TenElemType> *> &mpo,
+    const TdvpParams &tdvp_params) {
+  using TenType = GQTensor<TenElemType>;
+  assert(mps.size() == mpo.size());
+  auto N = mps.size();
+  if (
+      tdvp_params.Scheme != kTdvpOneSite &&
+      tdvp_params.Scheme != kTdvpTwoSite) {
+    std::cout << "Unsupported TDVP scheme " << tdvp_params.Scheme << std::endl;
+    exit(1);
+  }
+  TenElemType coef;
+  GenTdvpCoef(tdvp_params.Tau / 2, tdvp_params.RealTime, coef);
+
+  // The sweeps start from the right canonical form.
+  MPS<TenType> rmps(mps, -1);
+  RightNormalizeMps(rmps, N-1, 1);
+  auto l_and_r_blocks = InitBlocks(mps, mpo, false);
+  auto &lblocks = l_and_r_blocks.first;
+  auto &rblocks = l_and_r_blocks.second;
+  lblocks.push_back(nullptr);
+  rblocks.push_back(GenRightBlock(rblocks[N-2], *mps[1], *mpo[1], 1, N));
+
+  std::cout << "\n";
+  Timer step_timer("step");
+  for (long step = 0; step < tdvp_params.Steps; ++step) {
+    std::cout << "step " << step << std::endl;
+    step_timer.Restart();
+    TdvpSweep(mps, mpo, lblocks, rblocks, tdvp_params, coef);
+    step_timer.PrintElapsed();
+    std::cout << "\n";
+  }
+
+  // Energy of the final state, whose center is site 0.
+  std::vector<TenType *> eff_ham = {lblocks[0], mpo[0], rblocks[N-1]};
+  auto eff_ham_mul_state = eff_ham_mul_state_lend1(eff_ham, mps[0]);
+  auto eng_ten = Contract(
+                     *eff_ham_mul_state, Dag(*mps[0]),
+                     {{0, 1}, {0, 1}});
+  auto norm_ten = Contract(*mps[0], Dag(*mps[0]), {{0, 1}, {0, 1}});
+  auto energy = Real(eng_ten->scalar) / Real(norm_ten->scalar);
+  delete eff_ham_mul_state;
+  delete eng_ten;
+  delete norm_ten;
+  for (auto &lblock : lblocks) { delete lblock; }
+  for (auto &rblock : rblocks) { delete rblock; }
+  return energy;
+}
+
+
+template <typename TenElemType>
+void TdvpSweep(
+    std::vector<GQTensor<TenElemType> *> &mps,
+    const std::vector<GQTensor<TenElemType> *> &mpo,
+    std::vector<GQTensor<TenElemType> *> &lblocks,
+    std::vector<GQTensor<TenElemType> *> &rblocks,
+    const TdvpParams &tdvp_params, const TenElemType coef) {
+  long N = mps.size();
+  switch (tdvp_params.Scheme) {
+    case kTdvpOneSite:
+      for (long i = 0; i < N; ++i) {
+        TdvpOneSiteUpdate(
+            i, mps, mpo, lblocks, rblocks, tdvp_params, coef, 'r');
+      }
+      for (long i = N-1; i >= 0; --i) {
+        TdvpOneSiteUpdate(
+            i, mps, mpo, lblocks, rblocks, tdvp_params, coef, 'l');
+      }
+      break;
+    case kTdvpTwoSite:
+      for (long i = 0; i < N-1; ++i) {
+        TdvpTwoSiteUpdate(
+            i, mps, mpo, lblocks, rblocks, tdvp_params, coef, 'r');
+      }
+      for (long i = N-1; i > 0; --i) {
+        TdvpTwoSiteUpdate(
+            i, mps, mpo, lblocks, rblocks, tdvp_params, coef, 'l');
+      }
+      break;
+    default:
+      std::cout << "Unsupported TDVP scheme " << tdvp_params.Scheme
+                << std::endl;
+      exit(1);
+  }
+}
+
+
+// Evolve site i forward. Then, if the center moves on, split the bond to the
+// next site off, grow the block and evolve the bond backward.
+template <typename TenElemType>
+void TdvpOneSiteUpdate(
+    const long i,
+    std::vector<GQTensor<TenElemType> *> &mps,
+    const std::vector<GQTensor<TenElemType> *> &mpo,
+    std::vector<GQTensor<TenElemType> *> &lblocks,
+    std::vector<GQTensor<TenElemType> *> &rblocks,
+    const TdvpParams &tdvp_params, const TenElemType coef, const char dir) {
+  using TenType = GQTensor<TenElemType>;
+  long N = mps.size();
+  std::string where;
+  if (i == 0) {
+    where = "lend1";
+  } else if (i == N-1) {
+    where = "rend1";
+  } else {
+    where = "cent1";
+  }
+  std::vector<TenType *> eff_ham = {lblocks[i], mpo[i], rblocks[N-1-i]};
+  TdvpEvolve(eff_ham, mps[i], coef, tdvp_params, where);
+
+  TenType *bond_state;
+  switch (dir) {
+    case 'r': {
+      if (i == N-1) { return; }
+      auto svd_res = Svd(
+                         *mps[i],
+                         (i == 0) ? 1 : 2, 1,
+                         Div(*mps[i]), Div(*mps[i+1]));
+      delete mps[i];
+      mps[i] = svd_res.u;
+      bond_state = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      delete svd_res.s;
+      delete svd_res.v;
+
+      delete lblocks[i+1];
+      lblocks[i+1] = GenLeftBlock(lblocks[i], *mps[i], *mpo[i], i);
+      eff_ham = {lblocks[i+1], rblocks[N-1-i]};
+      TdvpEvolve(eff_ham, bond_state, -coef, tdvp_params, "bond");
+
+      auto next_ten = Contract(*bond_state, *mps[i+1], {{1}, {0}});
+      delete bond_state;
+      delete mps[i+1];
+      mps[i+1] = next_ten;
+      break;
+    }
+    case 'l': {
+      if (i == 0) { return; }
+      auto svd_res = Svd(
+                         *mps[i],
+                         1, (i == N-1) ? 1 : 2,
+                         Div(*mps[i-1]), Div(*mps[i]));
+      delete mps[i];
+      mps[i] = svd_res.v;
+      bond_state = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+      delete svd_res.u;
+      delete svd_res.s;
+
+      delete rblocks[N-i];
+      rblocks[N-i] = GenRightBlock(rblocks[N-1-i], *mps[i], *mpo[i], i, N);
+      eff_ham = {lblocks[i], rblocks[N-i]};
+      TdvpEvolve(eff_ham, bond_state, -coef, tdvp_params, "bond");
+
+      long prev_ten_ctrct_axis = (i-1 == 0) ? 1 : 2;
+      auto prev_ten = Contract(
+                          *mps[i-1], *bond_state,
+                          {{prev_ten_ctrct_axis}, {0}});
+      delete bond_state;
+      delete mps[i-1];
+      mps[i-1] = prev_ten;
+      break;
+    }
+    default:
+      std::cout << "dir must be 'r' or 'l', but " << dir << std::endl;
+      exit(1);
+  }
+}
+
+
+// Evolve the two sites forward and split them by a truncated SVD. Then, if
+// the center moves on, grow the block and evolve the new center site backward.
+template <typename TenElemType>
+void TdvpTwoSiteUpdate(
+    const long i,
+    std::vector<GQTensor<TenElemType> *> &mps,
+    const std::vector<GQTensor<TenElemType> *> &mpo,
+    std::vector<GQTensor<TenElemType> *> &lblocks,
+    std::vector<GQTensor<TenElemType> *> &rblocks,
+    const TdvpParams &tdvp_params, const TenElemType coef, const char dir) {
+  using TenType = GQTensor<TenElemType>;
+  long N = mps.size();
+  long lsite_idx, rsite_idx;
+  switch (dir) {
+    case 'r':
+      lsite_idx = i;
+      rsite_idx = i+1;
+      break;
+    case 'l':
+      lsite_idx = i-1;
+      rsite_idx = i;
+      break;
+    default:
+      std::cout << "dir must be 'r' or 'l', but " << dir << std::endl;
+      exit(1);
+  }
+
+  std::string where = "cent";
+  std::vector<std::vector<long>> init_state_ctrct_axes = {{2}, {0}};
+  long svd_ldims = 2;
+  long svd_rdims = 2;
+  if (lsite_idx == 0) {
+    where = "lend";
+    init_state_ctrct_axes = {{1}, {0}};
+    svd_ldims = 1;
+  } else if (rsite_idx == N-1) {
+    where = "rend";
+    svd_rdims = 1;
+  }
+
+  std::vector<TenType *> eff_ham = {
+                                       lblocks[lsite_idx],
+                                       mpo[lsite_idx], mpo[rsite_idx],
+                                       rblocks[N-1-rsite_idx]
+                                   };
+  auto state = Contract(
+                   *mps[lsite_idx], *mps[rsite_idx],
+                   init_state_ctrct_axes);
+  TdvpEvolve(eff_ham, state, coef, tdvp_params, where);
+  auto svd_res = Svd(
+      *state,
+      svd_ldims, svd_rdims,
+      Div(*mps[lsite_idx]), Div(*mps[rsite_idx]),
+      tdvp_params.Cutoff,
+      tdvp_params.Dmin, tdvp_params.Dmax);
+  delete state;
+  delete mps[lsite_idx];
+  delete mps[rsite_idx];
+
+  switch (dir) {
+    case 'r':
+      mps[lsite_idx] = svd_res.u;
+      mps[rsite_idx] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      delete svd_res.s;
+      delete svd_res.v;
+      if (rsite_idx != N-1) {
+        delete lblocks[rsite_idx];
+        lblocks[rsite_idx] = GenLeftBlock(
+                                 lblocks[lsite_idx],
+                                 *mps[lsite_idx], *mpo[lsite_idx],
+                                 lsite_idx);
+        eff_ham = {lblocks[rsite_idx], mpo[rsite_idx], rblocks[N-1-rsite_idx]};
+        TdvpEvolve(eff_ham, mps[rsite_idx], -coef, tdvp_params, "cent1");
+      }
+      break;
+    case 'l':
+      mps[lsite_idx] = Contract(*svd_res.u, *svd_res.s, {{svd_ldims}, {0}});
+      mps[rsite_idx] = svd_res.v;
+      delete svd_res.u;
+      delete svd_res.s;
+      // The right block which covers N-1 sites is kept for the energy.
+      delete rblocks[N-rsite_idx];
+      rblocks[N-rsite_idx] = GenRightBlock(
+                                 rblocks[N-1-rsite_idx],
+                                 *mps[rsite_idx], *mpo[rsite_idx],
+                                 rsite_idx, N);
+      if (lsite_idx != 0) {
+        eff_ham = {lblocks[lsite_idx], mpo[lsite_idx], rblocks[N-rsite_idx]};
+        TdvpEvolve(eff_ham, mps[lsite_idx], -coef, tdvp_params, "cent1");
+      }
+      break;
+  }
+}
+} /* gqmps2 */
@@ -12,6 +12,18 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <deque>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
 
 #include <assert.h>
 
@@ -26,33 +38,1658 @@ using namespace gqten;
 
 
 // Forward declarations
+template<typename TenType>
+std::pair<std::vector<TenType *>, std::vector<TenType *>> InitBlocks(
+    const std::vector<TenType *> &, const std::vector<TenType *> &,
+    const bool, const bool distributed = false);
+
+template <typename TenType>
+struct ProjStates;
+
+template <typename TenType>
+ProjStates<TenType> InitProjStates(
+    const std::vector<TenType *> &,
+    const std::vector<std::vector<TenType *>> &,
+    const double);
+
+template <typename TenType>
+struct Targets;
+
+template <typename TenType>
+bool RealTwoSiteAlgorithmImpl(
+    std::vector<TenType *> &, const std::vector<TenType *> &,
+    const SweepParams &,
+    const std::vector<std::vector<TenType *>> &, const double,
+    Targets<TenType> &,
+    EntSpec *,
+    double &);
+
+template <typename TenType>
+std::vector<TenType *> InitParallelSegments(
+    std::vector<TenType *> &, const std::vector<TenType *> &,
+    const std::vector<long> &, const std::vector<long> &,
+    std::vector<TenType *> &,
+    const unsigned);
+
+template <typename TenType>
+double ParallelBoundaryUpdate(
+    const long,
+    std::vector<TenType *> &, const std::vector<TenType *> &,
+    std::vector<TenType *> &, std::vector<TenType *> &,
+    TenType *&,
+    const SweepParams &,
+    std::ostream &);
+
+inline GQTensor<GQTEN_Double> *GenInvSvals(const GQTensor<GQTEN_Double> &);
+
+template <typename TenType>
+TenType *DistGenLeftBlock(
+    const TenType *, const TenType &, const TenType &, const long);
+
+template <typename TenType>
+TenType *DistGenRightBlock(
+    const TenType *, const TenType &, const TenType &, const long, const long);
+
+template <typename TenType>
+std::vector<TenType *> GenDistEffHam(
+    const std::vector<TenType *> &, const std::string &);
+
+template <typename TenElemType>
+GQTensor<TenElemType> *GenDistSlice(const GQTensor<TenElemType> &, const long);
+
+template <typename TenElemType>
+void DistAllReduceSum(GQTensor<TenElemType> * &, const QN &);
+
+
+// Helpers
+inline double MeasureEE(const DGQTensor *s, const long sdim) {
+  double ee = 0;
+  double p;
+  for (long i = 0; i < sdim; ++i) {
+    p = std::pow(s->Elem({i, i}), 2.0);
+    ee += (-p * std::log(p));
+  }
+  return ee;
+}
+
+
+inline BondEntSpec GenBondEntSpec(const GQTensor<GQTEN_Double> &s) {
+  BondEntSpec bond_ent_spec;
+  long offset = 0;
+  for (auto &qnsct : s.indexes[0].qnscts) {
+    std::vector<double> svals(qnsct.dim);
+    for (long i = 0; i < qnsct.dim; ++i) {
+      svals[i] = s.Elem({offset+i, offset+i});
+    }
+    bond_ent_spec.qns.push_back(qnsct.qn);
+    bond_ent_spec.svals.push_back(svals);
+    offset += qnsct.dim;
+  }
+  return bond_ent_spec;
+}
+
+
+inline double RenyiEntropy(const BondEntSpec &bond_ent_spec, const double alpha) {
+  double ee = 0;
+  double p;
+  for (auto &svals : bond_ent_spec.svals) {
+    for (auto sval : svals) {
+      p = sval * sval;
+      if (p == 0) { continue; }
+      if (alpha == 1) {
+        ee += (-p * std::log(p));
+      } else {
+        ee += std::pow(p, alpha);
+      }
+    }
+  }
+  if (alpha == 1) { return ee; }
+  return std::log(ee) / (1 - alpha);
+}
+
+
+// The spectra are dumped as a list of bonds. Each bond holds a list of
+// sectors and each sector holds its quantum numbers and Schmidt values.
+inline void DumpEntSpec(
+    const EntSpec &ent_spec, const std::string &basename, const char format) {
+  json bonds = json::array();
+  for (std::size_t i = 0; i < ent_spec.size(); ++i) {
+    auto &bond_ent_spec = ent_spec[i];
+    json sectors = json::array();
+    for (std::size_t j = 0; j < bond_ent_spec.qns.size(); ++j) {
+      json qn = json::object();
+      for (auto &qnnameval : bond_ent_spec.qns[j].nm_vals) {
+        qn[qnnameval.name] = qnnameval.val;
+      }
+      sectors.push_back({{"qn", qn}, {"svals", bond_ent_spec.svals[j]}});
+    }
+    bonds.push_back({{"bond", i}, {"sectors", sectors}});
+  }
+
+  std::ofstream ofs;
+  switch (format) {
+    case kEntSpecFormatJson:
+      ofs.open(basename + ".json");
+      ofs << bonds.dump(2);
+      break;
+    case kEntSpecFormatMsgPack:
+      ofs.open(basename + ".msgpack", std::ios::binary);
+      json::to_msgpack(bonds, ofs);
+      break;
+    default:
+      std::cout << "Unsupported entanglement spectrum format " << format
+                << std::endl;
+      exit(1);
+  }
+  ofs.close();
+}
+
+
+template <typename T>
+inline T ScheduleAt(
+    const std::vector<T> &schedule, const long sweep, const T default_val) {
+  if (schedule.empty()) { return default_val; }
+  if (sweep < (long)schedule.size()) { return schedule[sweep]; }
+  return schedule.back();
+}
+
+
+inline SweepParams SweepParamsAt(
+    const SweepParams &sweep_params, const long sweep) {
+  SweepParams sweep_params_at(sweep_params);
+  sweep_params_at.Dmax = ScheduleAt(
+                             sweep_params.DmaxSchedule, sweep,
+                             sweep_params.Dmax);
+  sweep_params_at.Dmin = std::min(sweep_params.Dmin, sweep_params_at.Dmax);
+  sweep_params_at.Cutoff = ScheduleAt(
+                               sweep_params.CutoffSchedule, sweep,
+                               sweep_params.Cutoff);
+  sweep_params_at.LanczParams.error = ScheduleAt(
+                                          sweep_params.LanczErrSchedule, sweep,
+                                          sweep_params.LanczParams.error);
+  sweep_params_at.Noise = ScheduleAt(
+                              sweep_params.NoiseSchedule, sweep,
+                              sweep_params.Noise);
+  return sweep_params_at;
+}
+
+
+inline double AdaptiveLanczErr(
+    const SweepParams &sweep_params,
+    const double last_trunc_err, const double sweep_eng_diff) {
+  auto err = sweep_params.LanczErrRatio *
+             std::max(last_trunc_err, sweep_eng_diff);
+  return std::min(
+             std::max(err, sweep_params.LanczErrFloor),
+             sweep_params.LanczErrCeil);
+}
+
+
+inline std::string GenBlockFileName(
+    const std::string &dir, const long blk_len) {
+  std::string rank_suffix;
+  if (DistSize() > 1) { rank_suffix = "_" + std::to_string(DistRank()); }
+  return kRuntimeTempPath + "/" +
+         dir + kBlockFileBaseName + std::to_string(blk_len) + rank_suffix +
+         "." + kGQTenFileSuffix;
+}
+
+
+inline void RemoveFile(const std::string &file) {
+  if (std::remove(file.c_str())) {
+    std::cout << "Unable to delete " << file << std::endl;
+    exit(1);
+  }
+}
+
+
+// Background worker of the block files, which lets the updates of the sweep
+// overlap their reading, dumping and removing of the blocks with the
+// Lanczos and the SVD. The tasks run on one thread in the order they are
+// pushed, so the tasks on a file keep their order: a block is read only after
+// it is dumped and removed only after it is read. The thread is started by
+// the first task.
+template <typename TenType>
+struct BlockIo {
+  std::thread worker;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::function<void(void)>> tasks;
+  long pending = 0;
+  bool stop = false;
+  std::map<std::string, std::future<TenType *>> prefetches;
+};
+
+
+template <typename TenType>
+void BlockIoLoop(BlockIo<TenType> &io) {
+  std::unique_lock<std::mutex> lock(io.mtx);
+  while (true) {
+    io.cv.wait(lock, [&io](void) { return io.stop || !io.tasks.empty(); });
+    if (io.tasks.empty()) { return; }
+    auto task = std::move(io.tasks.front());
+    io.tasks.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    --io.pending;
+    io.cv.notify_all();
+  }
+}
+
+
+template <typename TenType>
+void PushBlockIo(BlockIo<TenType> &io, std::function<void(void)> task) {
+  {
+    std::lock_guard<std::mutex> lock(io.mtx);
+    if (!io.worker.joinable()) {
+      io.worker = std::thread(BlockIoLoop<TenType>, std::ref(io));
+    }
+    io.tasks.push_back(std::move(task));
+    ++io.pending;
+  }
+  io.cv.notify_all();
+}
+
+
+// Wait until all the pushed tasks are done.
+template <typename TenType>
+void WaitBlockIo(BlockIo<TenType> &io) {
+  std::unique_lock<std::mutex> lock(io.mtx);
+  io.cv.wait(lock, [&io](void) { return io.pending == 0; });
+}
+
+
+// Finish the tasks and stop the thread. The blocks read ahead but never taken
+// are freed.
+template <typename TenType>
+void StopBlockIo(BlockIo<TenType> &io) {
+  WaitBlockIo(io);
+  if (io.worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(io.mtx);
+      io.stop = true;
+    }
+    io.cv.notify_all();
+    io.worker.join();
+    io.stop = false;
+  }
+  for (auto &prefetch : io.prefetches) { delete prefetch.second.get(); }
+  io.prefetches.clear();
+}
+
+
+// Read the block file ahead, for a later TakeBlock.
+template <typename TenType>
+void PrefetchBlock(BlockIo<TenType> &io, const std::string &file) {
+  auto promise = std::make_shared<std::promise<TenType *>>();
+  io.prefetches[file] = promise->get_future();
+  PushBlockIo(
+      io,
+      [promise, file](void) {
+        TenType *blk;
+        ReadGQTensorFromFile(blk, file);
+        promise->set_value(blk);
+      });
+}
+
+
+// The block of the file, read ahead or read now after the pushed tasks.
+template <typename TenType>
+TenType *TakeBlock(BlockIo<TenType> &io, const std::string &file) {
+  TenType *blk;
+  auto prefetch = io.prefetches.find(file);
+  if (prefetch != io.prefetches.end()) {
+    blk = prefetch->second.get();
+    io.prefetches.erase(prefetch);
+  } else {
+    WaitBlockIo(io);
+    ReadGQTensorFromFile(blk, file);
+  }
+  return blk;
+}
+
+
+// The block must be kept until the dump is done, see WaitBlockIo.
+template <typename TenType>
+void DumpBlock(
+    BlockIo<TenType> &io, const TenType *blk, const std::string &file) {
+  PushBlockIo(io, [blk, file](void) { WriteGQTensorTOFile(*blk, file); });
+}
+
+
+template <typename TenType>
+void RemoveBlockFile(BlockIo<TenType> &io, const std::string &file) {
+  PushBlockIo(io, [file](void) { RemoveFile(file); });
+}
+
+
+// Grow the left environment of <bra_mps|mpo|ket_mps> by a body site, whose
+// MPS tensors have the legs (l, p, r) and MPO tensor (l, p_in, p_out, r).
+template <typename TenType>
+TenType *GenBodyLeftMpoOverlapEnv(
+    const TenType &lenv, const TenType &ket_ten, const TenType &mpo_ten,
+    const TenType &bra_ten) {
+  auto new_lenv = Contract(lenv, ket_ten, {{0}, {0}});
+  auto temp_new_lenv = Contract(*new_lenv, mpo_ten, {{0, 2}, {0, 1}});
+  delete new_lenv;
+  new_lenv = temp_new_lenv;
+  temp_new_lenv = Contract(*new_lenv, Dag(bra_ten), {{0, 2}, {0, 1}});
+  delete new_lenv;
+  return temp_new_lenv;
+}
+
+
+// Grow the right environment of <bra_mps|mpo|ket_mps> by a body site.
+template <typename TenType>
+TenType *GenBodyRightMpoOverlapEnv(
+    const TenType &renv, const TenType &ket_ten, const TenType &mpo_ten,
+    const TenType &bra_ten) {
+  auto new_renv = Contract(ket_ten, renv, {{2}, {0}});
+  auto temp_new_renv = Contract(*new_renv, mpo_ten, {{1, 2}, {1, 3}});
+  delete new_renv;
+  new_renv = temp_new_renv;
+  temp_new_renv = Contract(*new_renv, Dag(bra_ten), {{3, 1}, {1, 2}});
+  delete new_renv;
+  return temp_new_renv;
+}
+
+
+// Grow the left environment of <bra_mps|mpo|ket_mps>, which ends at site-1, to
+// site. The legs are (ket, mpo, bra) and lenv is not used when site is 0.
+template <typename TenType>
+TenType *GenLeftMpoOverlapEnv(
+    const TenType *lenv, const TenType &ket_ten, const TenType &mpo_ten,
+    const TenType &bra_ten, const long site) {
+  if (site != 0) {
+    return GenBodyLeftMpoOverlapEnv(*lenv, ket_ten, mpo_ten, bra_ten);
+  }
+  auto new_lenv = Contract(ket_ten, mpo_ten, {{0}, {0}});
+  auto temp_new_lenv = Contract(*new_lenv, Dag(bra_ten), {{2}, {0}});
+  delete new_lenv;
+  return temp_new_lenv;
+}
+
+
+// Grow the right environment of <bra_mps|mpo|ket_mps>, which starts at
+// site+1, to site. The legs are (ket, mpo, bra) and renv is not used when
+// site is N-1.
+template <typename TenType>
+TenType *GenRightMpoOverlapEnv(
+    const TenType *renv, const TenType &ket_ten, const TenType &mpo_ten,
+    const TenType &bra_ten, const long site, const long N) {
+  if (site != N-1) {
+    return GenBodyRightMpoOverlapEnv(*renv, ket_ten, mpo_ten, bra_ten);
+  }
+  auto new_renv = Contract(ket_ten, mpo_ten, {{1}, {0}});
+  auto temp_new_renv = Contract(*new_renv, Dag(bra_ten), {{2}, {1}});
+  delete new_renv;
+  return temp_new_renv;
+}
+
+
+// Grow the left block, which ends at site-1, to site. The lblock is not used
+// when site is 0.
+template <typename TenType>
+TenType *GenLeftBlock(
+    const TenType *lblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long site) {
+  return GenLeftMpoOverlapEnv(lblock, mps_ten, mpo_ten, mps_ten, site);
+}
+
+
+// Grow the right block, which starts at site+1, to site. The rblock is not
+// used when site is N-1.
+template <typename TenType>
+TenType *GenRightBlock(
+    const TenType *rblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long site, const long N) {
+  return GenRightMpoOverlapEnv(rblock, mps_ten, mpo_ten, mps_ten, site, N);
+}
+
+
+// Grow the left block by a body site, which does not depend on where the
+// site is in the chain.
+template <typename TenType>
+TenType *GenBodyLeftBlock(
+    const TenType &lblock, const TenType &mps_ten, const TenType &mpo_ten) {
+  return GenBodyLeftMpoOverlapEnv(lblock, mps_ten, mpo_ten, mps_ten);
+}
+
+
+// Grow the right block by a body site.
+template <typename TenType>
+TenType *GenBodyRightBlock(
+    const TenType &rblock, const TenType &mps_ten, const TenType &mpo_ten) {
+  return GenBodyRightMpoOverlapEnv(rblock, mps_ten, mpo_ten, mps_ten);
+}
+
+
+// States projected out by the excited state search and their overlap
+// environments with the current state, indexed like the blocks.
+template <typename TenType>
+struct ProjStates {
+  std::vector<std::vector<TenType *>> mpss;
+  double weight;
+  std::vector<std::vector<TenType *>> lenvs;
+  std::vector<std::vector<TenType *>> renvs;
+};
+
+
+// Excited targets of the state-averaged algorithm. Their center tensors are
+// held here, the one of the lowest target is held by the MPS.
+template <typename TenType>
+struct Targets {
+  std::vector<TenType *> cent_tens;
+  std::vector<double> engs;
+};
+
+
+// Embedding of the index as the copy-th part of every sector of the index
+// whose sectors are enlarged copies times. The legs are (inversed index,
+// enlarged index).
+template <typename TenType>
+TenType *GenSectorEmbedding(
+    const Index &idx, const long copy, const long copies) {
+  std::vector<QNSector> enlarged_qnscts;
+  for (auto &qnsct : idx.qnscts) {
+    enlarged_qnscts.push_back(QNSector(qnsct.qn, copies * qnsct.dim));
+  }
+  auto embedding = new TenType(
+                       {InverseIndex(idx), Index(enlarged_qnscts, idx.dir)});
+  long offset = 0;
+  long enlarged_offset = 0;
+  for (auto &qnsct : idx.qnscts) {
+    for (long i = 0; i < qnsct.dim; ++i) {
+      (*embedding)({offset + i, enlarged_offset + copy*qnsct.dim + i}) = 1.0;
+    }
+    offset += qnsct.dim;
+    enlarged_offset += copies * qnsct.dim;
+  }
+  return embedding;
+}
+
+
+// Stack the targets along ext_leg, each with weight 1/sqrt(k).
+template <typename TenElemType>
+GQTensor<TenElemType> *StackTargets(
+    const std::vector<GQTensor<TenElemType> *> &tgt_states,
+    const long ext_leg) {
+  using TenType = GQTensor<TenElemType>;
+  long copies = tgt_states.size();
+  std::vector<TenType *> embedded_states;
+  for (long i = 0; i < copies; ++i) {
+    auto embedding = GenSectorEmbedding<TenType>(
+                         tgt_states[i]->indexes[ext_leg], i, copies);
+    if (ext_leg == 0) {
+      embedded_states.push_back(
+          Contract(*embedding, *tgt_states[i], {{0}, {0}}));
+    } else {
+      embedded_states.push_back(
+          Contract(*tgt_states[i], *embedding, {{ext_leg}, {0}}));
+    }
+    delete embedding;
+  }
+  auto stacked_state = new TenType(embedded_states[0]->indexes);
+  LinearCombine(
+      std::vector<TenElemType>(copies, 1.0 / std::sqrt(copies)),
+      embedded_states,
+      stacked_state);
+  for (auto &embedded_state : embedded_states) { delete embedded_state; }
+  return stacked_state;
+}
+
+
+// Solve the targets together and stack them with equal weights along the
+// enlarged ext_leg. The SVD of the stacked state truncates the bond by the
+// averaged reduced density matrix of the targets.
+template <typename TenElemType>
+LanczosRes<TenElemType> StateAvgLanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    const std::vector<GQTensor<TenElemType> *> &init_states,
+    const LanczosParams &params,
+    const std::string &where,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states,
+    const double penalty_weight,
+    const long ext_leg,
+    std::vector<GQTensor<TenElemType> *> &tgt_states,
+    std::vector<double> &engs) {
+  auto block_lancz_res = BlockLanczosSolver(
+                             eff_ham, init_states,
+                             params,
+                             where,
+                             penalty_states, penalty_weight);
+  tgt_states = block_lancz_res.vecs;
+  engs = block_lancz_res.engs;
+
+  LanczosRes<TenElemType> lancz_res;
+  lancz_res.iters = block_lancz_res.iters;
+  lancz_res.gs_eng = engs[0];
+  lancz_res.gs_vec = StackTargets(tgt_states, ext_leg);
+  return lancz_res;
+}
+
+
+// Untruncated solution of an update at a chain end. The update after the
+// sweep direction reverses is on the same two sites with the same effective
+// Hamiltonian, so it takes the solution instead of solving it again. The
+// states are the targets, or the single state.
+template <typename TenType>
+struct UpdateCache {
+  long lsite = -1;
+  double lancz_err;
+  double gs_eng;
+  std::vector<TenType *> states;
+  std::vector<double> engs;
+};
+
+
+template <typename TenType>
+void FreeUpdateCache(UpdateCache<TenType> &cache) {
+  for (auto &state : cache.states) { delete state; }
+  cache.states.clear();
+  cache.lsite = -1;
+}
+
+
+template <typename TenType>
+void SaveUpdateCache(
+    UpdateCache<TenType> &cache,
+    const long lsite, const double lancz_err, const double gs_eng,
+    const TenType *gs_vec,
+    const std::vector<TenType *> &tgt_states,
+    const std::vector<double> &engs) {
+  FreeUpdateCache(cache);
+  cache.lsite = lsite;
+  cache.lancz_err = lancz_err;
+  cache.gs_eng = gs_eng;
+  cache.engs = engs;
+  if (tgt_states.empty()) {
+    cache.states.push_back(new TenType(*gs_vec));
+  } else {
+    for (auto &tgt_state : tgt_states) {
+      cache.states.push_back(new TenType(*tgt_state));
+    }
+  }
+}
+
+
+// Take the cached solution if it is of the two sites from lsite and solved
+// with a Lanczos error no larger than the given one. Otherwise the cache is
+// dropped and the result holds no state.
+template <typename TenElemType>
+LanczosRes<TenElemType> TakeUpdateCache(
+    UpdateCache<GQTensor<TenElemType>> &cache,
+    const long lsite, const double lancz_err,
+    const bool multi_target, const long ext_leg,
+    std::vector<GQTensor<TenElemType> *> &tgt_states,
+    std::vector<double> &engs) {
+  LanczosRes<TenElemType> lancz_res;
+  lancz_res.iters = 0;
+  lancz_res.gs_vec = nullptr;
+  if (cache.lsite != lsite || cache.lancz_err > lancz_err) {
+    FreeUpdateCache(cache);
+    return lancz_res;
+  }
+  lancz_res.gs_eng = cache.gs_eng;
+  if (multi_target) {
+    tgt_states = cache.states;
+    engs = cache.engs;
+    lancz_res.gs_vec = StackTargets(tgt_states, ext_leg);
+  } else {
+    lancz_res.gs_vec = cache.states[0];
+  }
+  cache.states.clear();
+  cache.lsite = -1;
+  return lancz_res;
+}
+
+
+// Move the centers of the targets to the other site of the update through the
+// kept singular vectors, which are U for dir 'r' and V for dir 'l'. Without
+// targets, the single state is passed as the only one. Returns the weight of
+// the first state in the kept subspace.
+template <typename TenType>
+double MoveTargetCents(
+    std::vector<TenType *> &tgt_states, const TenType &kept_vecs,
+    const char dir, const long svd_ldims, const long svd_rdims,
+    TenType * &cent_ten, std::vector<TenType *> &tgt_cent_tens) {
+  std::vector<long> state_axes, vecs_axes;
+  if (dir == 'r') {
+    for (long i = 0; i < svd_ldims; ++i) {
+      state_axes.push_back(i);
+      vecs_axes.push_back(i);
+    }
+  } else {
+    for (long i = 0; i < svd_rdims; ++i) {
+      state_axes.push_back(svd_ldims + i);
+      vecs_axes.push_back(1 + i);
+    }
+  }
+  double kept_weight = 0.0;
+  for (std::size_t i = 0; i < tgt_states.size(); ++i) {
+    tgt_states[i]->Normalize();
+    TenType *new_cent_ten;
+    if (dir == 'r') {
+      new_cent_ten = Contract(
+                         Dag(kept_vecs), *tgt_states[i],
+                         {vecs_axes, state_axes});
+    } else {
+      new_cent_ten = Contract(
+                         *tgt_states[i], Dag(kept_vecs),
+                         {state_axes, vecs_axes});
+    }
+    delete tgt_states[i];
+    auto kept_norm = new_cent_ten->Normalize();
+    if (i == 0) {
+      kept_weight = kept_norm * kept_norm;
+      cent_ten = new_cent_ten;
+    } else {
+      delete tgt_cent_tens[i-1];
+      tgt_cent_tens[i-1] = new_cent_ten;
+    }
+  }
+  tgt_states.clear();
+  return kept_weight;
+}
+
+
+// Real copy of the complex tensor, which is divided by the phase of its
+// element of the largest modulus when rm_phase is true. If an imaginary part
+// is larger than kRealTenImagTol times the largest modulus, nullptr is
+// returned.
+inline GQTensor<GQTEN_Double> *GenRealTen(
+    const GQTensor<GQTEN_Complex> &ten, const bool rm_phase) {
+  double max_abs = 0.0;
+  GQTEN_Complex phase = 1.0;
+  for (auto &blk : ten.cblocks()) {
+    auto data = blk->cdata();
+    for (long j = 0; j < blk->size; ++j) {
+      if (std::abs(data[j]) > max_abs) {
+        max_abs = std::abs(data[j]);
+        phase = data[j] / max_abs;
+      }
+    }
+  }
+  if (!rm_phase) { phase = 1.0; }
+  auto real_ten = new GQTensor<GQTEN_Double>(ten.indexes);
+  for (auto &blk : ten.cblocks()) {
+    auto data = blk->cdata();
+    auto real_blk = new QNBlock<GQTEN_Double>(blk->qnscts);
+    auto real_data = real_blk->data();
+    for (long j = 0; j < blk->size; ++j) {
+      auto elem = data[j] * std::conj(phase);
+      if (std::abs(elem.imag()) > kRealTenImagTol * max_abs) {
+        delete real_blk;
+        delete real_ten;
+        return nullptr;
+      }
+      real_data[j] = elem.real();
+    }
+    real_ten->blocks().push_back(real_blk);
+  }
+  return real_ten;
+}
+
+
+// Real tensors are handled in real already.
+inline GQTensor<GQTEN_Double> *GenRealTen(
+    const GQTensor<GQTEN_Double> &, const bool) {
+  return nullptr;
+}
+
+
+// Real copies of the tensors, or false if any of them has none.
+template <typename TenType>
+bool GenRealTens(
+    const std::vector<TenType *> &tens, const bool rm_phase,
+    std::vector<GQTensor<GQTEN_Double> *> &real_tens) {
+  for (auto &ten : tens) {
+    auto real_ten = GenRealTen(*ten, rm_phase);
+    if (real_ten == nullptr) {
+      for (auto &t : real_tens) { delete t; }
+      real_tens.clear();
+      return false;
+    }
+    real_tens.push_back(real_ten);
+  }
+  return true;
+}
+
+
+template <typename TenElemType>
+void CopyRealBlocks(
+    const GQTensor<GQTEN_Double> &real_ten, GQTensor<TenElemType> &ten) {
+  ten.scalar = real_ten.scalar;
+  for (auto &real_blk : real_ten.cblocks()) {
+    auto blk = new QNBlock<TenElemType>(real_blk->qnscts);
+    std::copy(
+        real_blk->cdata(), real_blk->cdata() + real_blk->size, blk->data());
+    ten.blocks().push_back(blk);
+  }
+}
+
+
+template <typename TenType>
+TenType *GenPromotedTen(const GQTensor<GQTEN_Double> &real_ten) {
+  auto ten = new TenType(real_ten.indexes);
+  CopyRealBlocks(real_ten, *ten);
+  return ten;
+}
+
+
+// The real blocks on disk are promoted in place one by one. Like after
+// InitBlocks, the sweeps leave the right blocks and the empty left block.
+template <typename TenType>
+void PromoteBlockFiles(const long N) {
+  std::vector<std::string> files = {GenBlockFileName("l", 0)};
+  for (long blk_len = 0; blk_len < N-1; ++blk_len) {
+    files.push_back(GenBlockFileName("r", blk_len));
+  }
+  for (auto &file : files) {
+    GQTensor<GQTEN_Double> *real_blk;
+    ReadGQTensorFromFile(real_blk, file);
+    auto blk = GenPromotedTen<TenType>(*real_blk);
+    delete real_blk;
+    WriteGQTensorTOFile(*blk, file);
+    delete blk;
+  }
+}
+
+
+// Fusion of the indexes into one with the given direction. The legs are
+// (inversed lidx, inversed ridx, fused index).
+template <typename TenType>
+TenType *GenFusionTen(
+    const Index &lidx, const Index &ridx, const GQTenIndexDirType dir) {
+  std::vector<QN> qns;
+  std::vector<long> dims;
+  std::vector<std::vector<long>> pair_offsets(
+                                     lidx.qnscts.size(),
+                                     std::vector<long>(ridx.qnscts.size()));
+  for (std::size_t i = 0; i < lidx.qnscts.size(); ++i) {
+    for (std::size_t j = 0; j < ridx.qnscts.size(); ++j) {
+      auto &lqnsct = lidx.qnscts[i];
+      auto &rqnsct = ridx.qnscts[j];
+      auto flow = IndexFlowQn(lidx, lqnsct.qn) + IndexFlowQn(ridx, rqnsct.qn);
+      auto qn = (dir == OUT) ? flow : -flow;
+      std::size_t k = 0;
+      while (k < qns.size() && qns[k] != qn) { ++k; }
+      if (k == qns.size()) {
+        qns.push_back(qn);
+        dims.push_back(0);
+      }
+      pair_offsets[i][j] = dims[k];
+      dims[k] += lqnsct.dim * rqnsct.dim;
+    }
+  }
+  std::vector<QNSector> qnscts;
+  std::vector<long> sct_offsets;
+  long offset = 0;
+  for (std::size_t k = 0; k < qns.size(); ++k) {
+    qnscts.push_back(QNSector(qns[k], dims[k]));
+    sct_offsets.push_back(offset);
+    offset += dims[k];
+  }
+  auto fused_idx = Index(qnscts, dir);
+  auto fusion_ten = new TenType(
+                        {InverseIndex(lidx), InverseIndex(ridx), fused_idx});
+
+  long loffset = 0;
+  for (std::size_t i = 0; i < lidx.qnscts.size(); ++i) {
+    auto &lqnsct = lidx.qnscts[i];
+    long roffset = 0;
+    for (std::size_t j = 0; j < ridx.qnscts.size(); ++j) {
+      auto &rqnsct = ridx.qnscts[j];
+      auto flow = IndexFlowQn(lidx, lqnsct.qn) + IndexFlowQn(ridx, rqnsct.qn);
+      auto qn = (dir == OUT) ? flow : -flow;
+      std::size_t k = 0;
+      while (qns[k] != qn) { ++k; }
+      for (long l = 0; l < lqnsct.dim; ++l) {
+        for (long r = 0; r < rqnsct.dim; ++r) {
+          (*fusion_ten)({
+              loffset + l, roffset + r,
+              sct_offsets[k] + pair_offsets[i][j] + l*rqnsct.dim + r}) = 1.0;
+        }
+      }
+      roffset += rqnsct.dim;
+    }
+    loffset += lqnsct.dim;
+  }
+  return fusion_ten;
+}
+
+
+// Embeddings of the indexes, which have the same direction, into their direct
+// sum. The legs of each embedding are (inversed index, direct sum index).
+template <typename TenType>
+std::vector<TenType *> GenDirectSumEmbeddings(const std::vector<Index> &idxs) {
+  std::vector<QN> qns;
+  std::vector<long> dims;
+  for (auto &idx : idxs) {
+    assert(idx.dir == idxs[0].dir);
+    for (auto &qnsct : idx.qnscts) {
+      std::size_t k = 0;
+      while (k < qns.size() && qns[k] != qnsct.qn) { ++k; }
+      if (k == qns.size()) {
+        qns.push_back(qnsct.qn);
+        dims.push_back(0);
+      }
+      dims[k] += qnsct.dim;
+    }
+  }
+  std::vector<QNSector> qnscts;
+  std::vector<long> sct_offsets;
+  long offset = 0;
+  for (std::size_t k = 0; k < qns.size(); ++k) {
+    qnscts.push_back(QNSector(qns[k], dims[k]));
+    sct_offsets.push_back(offset);
+    offset += dims[k];
+  }
+  auto sum_idx = Index(qnscts, idxs[0].dir);
+
+  std::vector<TenType *> embeddings;
+  for (auto &idx : idxs) {
+    auto embedding = new TenType({InverseIndex(idx), sum_idx});
+    long idx_offset = 0;
+    for (auto &qnsct : idx.qnscts) {
+      std::size_t k = 0;
+      while (qns[k] != qnsct.qn) { ++k; }
+      for (long i = 0; i < qnsct.dim; ++i) {
+        (*embedding)({idx_offset + i, sct_offsets[k] + i}) = 1.0;
+      }
+      idx_offset += qnsct.dim;
+      sct_offsets[k] += qnsct.dim;
+    }
+    embeddings.push_back(embedding);
+  }
+  return embeddings;
+}
+
+
+// Density matrix perturbation. The half of the effective Hamiltonian on the
+// kept side is applied to the state, with its MPO bond left open and fused to
+// the truncated leg. The SVD of the direct sum of the state and the weighted
+// perturbation truncates by rho + noise * sum_w Tr(P_w P_w^dag). In the
+// distributed mode, the blocks are the slices of the rank, the MPO tensor
+// next to the block is cut down to the same sectors, and the perturbation is
+// summed over the ranks.
+template <typename TenType>
+TenType *GenNoisePerturbedState(
+    const std::vector<TenType *> &eff_ham, const TenType &state,
+    const std::string &where, const char dir, const double noise,
+    const bool distributed) {
+  bool with_block = (dir == 'r') ? (where != "lend") : (where != "rend");
+  auto lmpo = eff_ham[1];
+  auto rmpo = eff_ham[2];
+  if (distributed && with_block) {
+    if (dir == 'r') {
+      lmpo = GenDistSlice(*eff_ham[1], 0);
+    } else {
+      rmpo = GenDistSlice(*eff_ham[2], 3);
+    }
+  }
+  TenType *perturb;
+  long rank = state.indexes.size();
+  switch (dir) {
+    case 'r':
+      if (where == "lend") {
+        perturb = Contract(state, *lmpo, {{0}, {0}});
+        perturb->Transpose({3, 0, 1, 2});
+      } else {
+        perturb = Contract(*eff_ham[0], state, {{0}, {0}});
+        InplaceContract(perturb, *lmpo, {{0, 2}, {0, 1}});
+        if (where == "cent") {
+          perturb->Transpose({0, 3, 1, 2, 4});
+        } else {
+          perturb->Transpose({0, 2, 1, 3});
+        }
+      }
+      break;
+    case 'l':
+      if (where == "rend") {
+        perturb = Contract(state, *rmpo, {{2}, {0}});
+        perturb->Transpose({2, 0, 1, 3});
+      } else {
+        perturb = Contract(state, *eff_ham[3], {{rank-1}, {0}});
+        InplaceContract(perturb, *rmpo, {{rank-2, rank-1}, {1, 3}});
+        if (where == "cent") {
+          perturb->Transpose({3, 0, 1, 4, 2});
+        } else {
+          perturb->Transpose({2, 0, 3, 1});
+        }
+      }
+      break;
+    default:
+      std::cout << "dir must be 'r' or 'l', but " << dir << std::endl;
+      exit(1);
+  }
+  if (distributed && with_block) {
+    DistAllReduceSum(perturb, Div(state));
+    if (dir == 'r') {
+      delete lmpo;
+    } else {
+      delete rmpo;
+    }
+  }
+
+  TenType *fusion_ten, *fused_perturb;
+  std::vector<TenType *> embeddings;
+  TenType *embedded_state, *embedded_perturb;
+  if (dir == 'r') {
+    auto &trunc_idx = state.indexes[rank-1];
+    fusion_ten = GenFusionTen<TenType>(
+                     perturb->indexes[rank-1], perturb->indexes[rank],
+                     trunc_idx.dir);
+    fused_perturb = Contract(*perturb, *fusion_ten, {{rank-1, rank}, {0, 1}});
+    embeddings = GenDirectSumEmbeddings<TenType>(
+                     {trunc_idx, fused_perturb->indexes[rank-1]});
+    embedded_state = Contract(state, *embeddings[0], {{rank-1}, {0}});
+    embedded_perturb = Contract(
+                           *fused_perturb, *embeddings[1], {{rank-1}, {0}});
+  } else {
+    auto &trunc_idx = state.indexes[0];
+    fusion_ten = GenFusionTen<TenType>(
+                     perturb->indexes[0], perturb->indexes[1],
+                     trunc_idx.dir);
+    fused_perturb = Contract(*fusion_ten, *perturb, {{0, 1}, {0, 1}});
+    embeddings = GenDirectSumEmbeddings<TenType>(
+                     {trunc_idx, fused_perturb->indexes[0]});
+    embedded_state = Contract(*embeddings[0], state, {{0}, {0}});
+    embedded_perturb = Contract(*embeddings[1], *fused_perturb, {{0}, {0}});
+  }
+  auto perturbed_state = new TenType(embedded_state->indexes);
+  LinearCombine(
+      {1.0, std::sqrt(noise)},
+      {embedded_state, embedded_perturb},
+      perturbed_state);
+  delete perturb;
+  delete fusion_ten;
+  delete fused_perturb;
+  for (auto &embedding : embeddings) { delete embedding; }
+  delete embedded_state;
+  delete embedded_perturb;
+  return perturbed_state;
+}
+
+
+// Sector combinations of some legs, with the offset of each one in the rows
+// of the group and the dimension of the group.
+struct SctCombos {
+  std::vector<std::vector<std::size_t>> scts;
+  std::vector<long> offsets;
+  long dim = 0;
+};
+
+
+// Sector combinations of the indexes grouped by their quantum number flows.
+// The rows of a group run over its combinations in order and over the
+// coordinates of each combination in row major order.
+inline void GroupSctCombosByFlow(
+    const std::vector<Index> &idxs,
+    std::vector<QN> &flows,
+    std::vector<SctCombos> &combos_grps) {
+  long rank = idxs.size();
+  std::vector<std::size_t> scts(rank, 0);
+  while (true) {
+    auto flow = IndexFlowQn(idxs[0], idxs[0].qnscts[scts[0]].qn);
+    long dim = idxs[0].qnscts[scts[0]].dim;
+    for (long i = 1; i < rank; ++i) {
+      flow += IndexFlowQn(idxs[i], idxs[i].qnscts[scts[i]].qn);
+      dim *= idxs[i].qnscts[scts[i]].dim;
+    }
+    std::size_t grp = 0;
+    while (grp < flows.size() && flows[grp] != flow) { ++grp; }
+    if (grp == flows.size()) {
+      flows.push_back(flow);
+      combos_grps.push_back(SctCombos());
+    }
+    auto &combos = combos_grps[grp];
+    combos.scts.push_back(scts);
+    combos.offsets.push_back(combos.dim);
+    combos.dim += dim;
+    long i;
+    for (i = rank-1; i >= 0; --i) {
+      if (++scts[i] < idxs[i].qnscts.size()) { break; }
+      scts[i] = 0;
+    }
+    if (i < 0) { return; }
+  }
+}
+
+
+// Number of the kept ones of the descending weights, the squared singular
+// values, by the truncation of Svd.
+inline long TruncDim(
+    const std::vector<double> &weights, const double tot,
+    const double cutoff, const long Dmin, const long Dmax) {
+  long D = 0;
+  double kept_weight = 0.0;
+  while (D < (long)weights.size() && (tot - kept_weight) / tot > cutoff) {
+    kept_weight += weights[D];
+    ++D;
+  }
+  if (D < Dmin) { D = std::min(Dmin, (long)weights.size()); }
+  if (D > Dmax) { D = Dmax; }
+  if (D < 1) { D = 1; }
+  return D;
+}
+
+
+// Run func(b) for every block on thread_num threads, from the most costly
+// block. A block which costs more than 1/thread_num of the total runs alone
+// with thread_num BLAS threads, the others run concurrently with one BLAS
+// thread each.
+template <typename FuncType>
+void ParallelForBlocks(
+    const std::vector<double> &costs, const unsigned thread_num,
+    FuncType func) {
+  std::vector<std::size_t> order(costs.size());
+  double tot_cost = 0.0;
+  for (std::size_t b = 0; b < costs.size(); ++b) {
+    order[b] = b;
+    tot_cost += costs[b];
+  }
+  if (thread_num <= 1) {
+    for (auto b : order) { func(b); }
+    return;
+  }
+  std::stable_sort(
+      order.begin(), order.end(),
+      [&costs](const std::size_t lhs, const std::size_t rhs) {
+        return costs[lhs] > costs[rhs];
+      });
+  std::size_t big_blks = 0;
+  while (big_blks < order.size() &&
+         costs[order[big_blks]] * thread_num > tot_cost) {
+    ++big_blks;
+  }
+  mkl_set_num_threads_local(thread_num);
+  for (std::size_t i = 0; i < big_blks; ++i) { func(order[i]); }
+  mkl_set_num_threads_local(0);
+  ParallelFor(
+      order.size() - big_blks, thread_num,
+      [&order, big_blks, &func](const std::size_t i) {
+        mkl_set_num_threads_local(1);
+        func(order[big_blks + i]);
+        mkl_set_num_threads_local(0);
+      });
+}
+
+
+// Quantum number blocks of a tensor as a matrix, whose rows are the first
+// ldims legs. A block pairs the rows and the columns of the same new bond
+// quantum number, which is udiv minus the flow of the rows and the flow of the
+// columns minus rdiv.
+struct TenMatBlocks {
+  std::vector<Index> lidxs;
+  std::vector<Index> ridxs;
+  std::vector<QN> qns;
+  std::vector<SctCombos> lcombos;
+  std::vector<SctCombos> rcombos;
+};
+
+
+inline TenMatBlocks GenTenMatBlocks(
+    const std::vector<Index> &idxs,
+    const long ldims, const long rdims,
+    const QN &udiv, const QN &rdiv) {
+  TenMatBlocks blks;
+  blks.lidxs.assign(idxs.begin(), idxs.begin() + ldims);
+  blks.ridxs.assign(idxs.begin() + ldims, idxs.begin() + ldims + rdims);
+  std::vector<QN> lflows, rflows;
+  std::vector<SctCombos> lcombos_grps, rcombos_grps;
+  GroupSctCombosByFlow(blks.lidxs, lflows, lcombos_grps);
+  GroupSctCombosByFlow(blks.ridxs, rflows, rcombos_grps);
+  for (std::size_t lg = 0; lg < lflows.size(); ++lg) {
+    auto qn = udiv - lflows[lg];
+    for (std::size_t rg = 0; rg < rflows.size(); ++rg) {
+      if (rflows[rg] - rdiv == qn) {
+        blks.qns.push_back(qn);
+        blks.lcombos.push_back(lcombos_grps[lg]);
+        blks.rcombos.push_back(rcombos_grps[rg]);
+        break;
+      }
+    }
+  }
+  return blks;
+}
+
+
+// Number of the sector of the index.
+inline std::size_t SctNum(const Index &idx, const QNSector &sct) {
+  std::size_t s = 0;
+  while (s < idx.qnscts.size() && !(idx.qnscts[s] == sct)) { ++s; }
+  assert(s < idx.qnscts.size());
+  return s;
+}
+
+
+// All the blocks of t as row major matrices, which are filled from the
+// blocks of t row by row.
+template <typename TenElemType>
+std::vector<std::vector<TenElemType>> GenDenseBlocks(
+    const GQTensor<TenElemType> &t, const TenMatBlocks &blks) {
+  long ldims = blks.lidxs.size();
+  long rank = t.indexes.size();
+  auto blk_num = blks.qns.size();
+  std::map<std::vector<std::size_t>, std::pair<std::size_t, long>> lposs, rposs;
+  std::vector<std::vector<TenElemType>> mats(blk_num);
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    auto &lcombos = blks.lcombos[b];
+    auto &rcombos = blks.rcombos[b];
+    for (std::size_t c = 0; c < lcombos.scts.size(); ++c) {
+      lposs[lcombos.scts[c]] = std::make_pair(b, lcombos.offsets[c]);
+    }
+    for (std::size_t c = 0; c < rcombos.scts.size(); ++c) {
+      rposs[rcombos.scts[c]] = std::make_pair(b, rcombos.offsets[c]);
+    }
+    mats[b].assign(lcombos.dim * rcombos.dim, 0.0);
+  }
+  for (auto &ten_blk : t.cblocks()) {
+    std::vector<std::size_t> lscts, rscts;
+    long m = 1;
+    for (long i = 0; i < rank; ++i) {
+      auto s = SctNum(t.indexes[i], ten_blk->qnscts[i]);
+      if (i < ldims) {
+        lscts.push_back(s);
+        m *= ten_blk->qnscts[i].dim;
+      } else {
+        rscts.push_back(s);
+      }
+    }
+    auto lpos = lposs.find(lscts);
+    auto rpos = rposs.find(rscts);
+    if (lpos == lposs.end() || rpos == rposs.end() ||
+        lpos->second.first != rpos->second.first) {
+      continue;
+    }
+    auto b = lpos->second.first;
+    long n = blks.rcombos[b].dim;
+    long blk_n = ten_blk->size / m;
+    auto data = ten_blk->cdata();
+    auto mat = mats[b].data() + lpos->second.second * n + rpos->second.second;
+    for (long i = 0; i < m; ++i) {
+      std::copy(data + i*blk_n, data + (i+1)*blk_n, mat + i*n);
+    }
+  }
+  return mats;
+}
+
+
+// Put the row major matrix, whose rows are of the lcombos of the first legs
+// of t and whose columns are of the rcombos of the other legs, into the
+// blocks of t row by row.
+template <typename TenElemType>
+void PutDenseBlock(
+    GQTensor<TenElemType> *t,
+    const SctCombos &lcombos, const SctCombos &rcombos,
+    const TenElemType *mat) {
+  long ldims = lcombos.scts[0].size();
+  long n = rcombos.dim;
+  for (std::size_t lc = 0; lc < lcombos.scts.size(); ++lc) {
+    for (std::size_t rc = 0; rc < rcombos.scts.size(); ++rc) {
+      std::vector<QNSector> qnscts;
+      long m = 1;
+      for (long i = 0; i < ldims; ++i) {
+        qnscts.push_back(t->indexes[i].qnscts[lcombos.scts[lc][i]]);
+        m *= qnscts.back().dim;
+      }
+      long blk_n = 1;
+      for (std::size_t i = 0; i < rcombos.scts[rc].size(); ++i) {
+        qnscts.push_back(t->indexes[ldims + i].qnscts[rcombos.scts[rc][i]]);
+        blk_n *= qnscts.back().dim;
+      }
+      auto ten_blk = new QNBlock<TenElemType>(qnscts);
+      auto blk_mat = mat + lcombos.offsets[lc] * n + rcombos.offsets[rc];
+      for (long i = 0; i < m; ++i) {
+        std::copy(
+            blk_mat + i*n, blk_mat + i*n + blk_n,
+            ten_blk->data() + i*blk_n);
+      }
+      t->blocks().push_back(ten_blk);
+    }
+  }
+}
 
 
-// Helpers
-inline double MeasureEE(const DGQTensor *s, const long sdim) {
-  double ee = 0;
-  double p;
-  for (long i = 0; i < sdim; ++i) {
-    p = std::pow(s->Elem({i, i}), 2.0);
-    ee += (-p * std::log(p));
+// Cost of the cubic decomposition of each block.
+inline std::vector<double> BlockCosts(const TenMatBlocks &blks) {
+  std::vector<double> costs;
+  for (std::size_t b = 0; b < blks.qns.size(); ++b) {
+    double m = blks.lcombos[b].dim;
+    double n = blks.rcombos[b].dim;
+    costs.push_back(m * n * std::min(m, n));
   }
-  return ee;
+  return costs;
 }
 
 
-inline std::string GenBlockFileName(
-    const std::string &dir, const long blk_len) {
-  return kRuntimeTempPath + "/" +
-         dir + kBlockFileBaseName + std::to_string(blk_len) +
-         "." + kGQTenFileSuffix;
+// Truncated SVD of t, whose first ldims legs are the rows, over its quantum
+// number blocks on thread_num threads, see ParallelForBlocks. The singular
+// values of all the blocks are merged and truncated like Svd. It is Svd if
+// thread_num is 1.
+template <typename TenElemType>
+SvdRes<TenElemType> BlockSvd(
+    const GQTensor<TenElemType> &t,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const double cutoff, const long Dmin, const long Dmax,
+    const unsigned thread_num) {
+  using TenType = GQTensor<TenElemType>;
+  if (thread_num <= 1) {
+    return Svd(t, ldims, rdims, ldiv, rdiv, cutoff, Dmin, Dmax);
+  }
+  auto blks = GenTenMatBlocks(t.indexes, ldims, rdims, ldiv, rdiv);
+  auto blk_num = blks.qns.size();
+  auto mats = GenDenseBlocks(t, blks);
+  std::vector<std::vector<double>> blk_svals(blk_num);
+  std::vector<std::vector<TenElemType>> blk_us(blk_num), blk_vts(blk_num);
+  ParallelForBlocks(
+      BlockCosts(blks), thread_num,
+      [&](const std::size_t b) {
+        long m = blks.lcombos[b].dim;
+        long n = blks.rcombos[b].dim;
+        blk_svals[b].resize(std::min(m, n));
+        MatSvdSolver(
+            mats[b], m, n, blk_svals[b].data(), blk_us[b], blk_vts[b]);
+        std::vector<TenElemType>().swap(mats[b]);
+      });
+
+  struct SvalRef { double sval; std::size_t blk; long k; };
+  std::vector<SvalRef> sval_refs;
+  double tot = 0.0;
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    for (long k = 0; k < (long)blk_svals[b].size(); ++k) {
+      sval_refs.push_back({blk_svals[b][k], b, k});
+      tot += blk_svals[b][k] * blk_svals[b][k];
+    }
+  }
+  std::stable_sort(
+      sval_refs.begin(), sval_refs.end(),
+      [](const SvalRef &a, const SvalRef &b) { return a.sval > b.sval; });
+  std::vector<double> weights;
+  for (auto &sval_ref : sval_refs) {
+    weights.push_back(sval_ref.sval * sval_ref.sval);
+  }
+  auto D = TruncDim(weights, tot, cutoff, Dmin, Dmax);
+  double kept_weight = 0.0;
+  std::vector<std::vector<long>> blk_kept(blk_num);
+  for (long k = 0; k < D; ++k) {
+    kept_weight += weights[k];
+    blk_kept[sval_refs[k].blk].push_back(sval_refs[k].k);
+  }
+
+  std::vector<QNSector> qnscts;
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    if (blk_kept[b].empty()) { continue; }
+    qnscts.push_back(QNSector(blks.qns[b], blk_kept[b].size()));
+  }
+  auto new_out = Index(qnscts, OUT);
+  auto new_in = InverseIndex(new_out);
+  auto uidxs = blks.lidxs;
+  uidxs.push_back(new_out);
+  std::vector<Index> vidxs = {new_in};
+  vidxs.insert(vidxs.end(), blks.ridxs.begin(), blks.ridxs.end());
+  SvdRes<TenElemType> svd_res;
+  svd_res.u = new TenType(uidxs);
+  svd_res.s = new GQTensor<GQTEN_Double>({new_in, new_out});
+  svd_res.v = new TenType(vidxs);
+  auto norm = std::sqrt(kept_weight);
+  long offset = 0;
+  std::size_t sct = 0;
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    if (blk_kept[b].empty()) { continue; }
+    long m = blks.lcombos[b].dim;
+    long n = blks.rcombos[b].dim;
+    long k = blk_svals[b].size();
+    long kept = blk_kept[b].size();
+    SctCombos bond_combos;
+    bond_combos.scts.push_back({sct});
+    bond_combos.offsets.push_back(0);
+    bond_combos.dim = kept;
+    std::vector<TenElemType> u_mat(m*kept), vt_mat(kept*n);
+    for (long c = 0; c < kept; ++c) {
+      auto kk = blk_kept[b][c];
+      (*svd_res.s)({offset, offset}) = blk_svals[b][kk] / norm;
+      for (long i = 0; i < m; ++i) { u_mat[i*kept + c] = blk_us[b][i*k + kk]; }
+      std::copy(
+          blk_vts[b].begin() + kk*n, blk_vts[b].begin() + (kk+1)*n,
+          vt_mat.begin() + c*n);
+      ++offset;
+    }
+    PutDenseBlock(svd_res.u, blks.lcombos[b], bond_combos, u_mat.data());
+    PutDenseBlock(svd_res.v, bond_combos, blks.rcombos[b], vt_mat.data());
+    ++sct;
+  }
+  svd_res.trunc_err = std::max(tot - kept_weight, 0.0) / tot;
+  svd_res.D = D;
+  return svd_res;
 }
 
 
-inline void RemoveFile(const std::string &file) {
-  if (std::remove(file.c_str())) {
-    std::cout << "Unable to delete " << file << std::endl;
-    exit(1);
+// QR decomposition of t, whose first ldims legs are the rows, over its quantum
+// number blocks on thread_num threads. The legs of q are (row legs, new bond)
+// and its columns are orthonormal, the legs of r are (inversed new bond,
+// column legs). The divergence of r is rdiv, like that of v of Svd. If lq is
+// true, t is decomposed into l, the first one, and q with orthonormal rows
+// instead. Each block is decomposed by ?geqrf and ?orgqr, r being upper and l
+// lower triangular in it.
+template <typename TenElemType>
+std::pair<GQTensor<TenElemType> *, GQTensor<TenElemType> *> BlockQr(
+    const GQTensor<TenElemType> &t,
+    const long ldims, const long rdims,
+    const QN &rdiv,
+    const bool lq,
+    const unsigned thread_num) {
+  using TenType = GQTensor<TenElemType>;
+  auto blks = GenTenMatBlocks(t.indexes, ldims, rdims, Div(t) - rdiv, rdiv);
+  auto blk_num = blks.qns.size();
+  auto mats = GenDenseBlocks(t, blks);
+  std::vector<std::vector<TenElemType>> blk_lhss(blk_num), blk_rhss(blk_num);
+  ParallelForBlocks(
+      BlockCosts(blks), thread_num,
+      [&](const std::size_t b) {
+        long m = blks.lcombos[b].dim;
+        long n = blks.rcombos[b].dim;
+        auto &mat = mats[b];
+        if (!lq) {
+          MatQrSolver(mat, m, n, blk_lhss[b], blk_rhss[b]);
+          std::vector<TenElemType>().swap(mat);
+          return;
+        }
+        // t = l q from the QR decomposition of its conjugate transpose.
+        std::vector<TenElemType> mat_dag(n*m);
+        for (long i = 0; i < m; ++i) {
+          for (long j = 0; j < n; ++j) {
+            mat_dag[j*m + i] = Conj(mat[i*n + j]);
+          }
+        }
+        std::vector<TenElemType>().swap(mat);
+        std::vector<TenElemType> q_dag, r_dag;
+        MatQrSolver(mat_dag, n, m, q_dag, r_dag);
+        long k = std::min(m, n);
+        blk_lhss[b].resize(m*k);
+        blk_rhss[b].resize(k*n);
+        for (long i = 0; i < m; ++i) {
+          for (long kk = 0; kk < k; ++kk) {
+            blk_lhss[b][i*k + kk] = Conj(r_dag[kk*m + i]);
+          }
+        }
+        for (long kk = 0; kk < k; ++kk) {
+          for (long j = 0; j < n; ++j) {
+            blk_rhss[b][kk*n + j] = Conj(q_dag[j*k + kk]);
+          }
+        }
+      });
+
+  std::vector<QNSector> qnscts;
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    long k = std::min(blks.lcombos[b].dim, blks.rcombos[b].dim);
+    qnscts.push_back(QNSector(blks.qns[b], k));
+  }
+  auto new_out = Index(qnscts, OUT);
+  auto lhs_idxs = blks.lidxs;
+  lhs_idxs.push_back(new_out);
+  std::vector<Index> rhs_idxs = {InverseIndex(new_out)};
+  rhs_idxs.insert(rhs_idxs.end(), blks.ridxs.begin(), blks.ridxs.end());
+  auto lhs = new TenType(lhs_idxs);
+  auto rhs = new TenType(rhs_idxs);
+  for (std::size_t b = 0; b < blk_num; ++b) {
+    SctCombos bond_combos;
+    bond_combos.scts.push_back({b});
+    bond_combos.offsets.push_back(0);
+    bond_combos.dim = qnscts[b].dim;
+    PutDenseBlock(lhs, blks.lcombos[b], bond_combos, blk_lhss[b].data());
+    PutDenseBlock(rhs, bond_combos, blks.rcombos[b], blk_rhss[b].data());
+  }
+  return std::make_pair(lhs, rhs);
+}
+
+
+// Truncated SVD from the reduced density matrix on the side of the isometry
+// which is kept, the left one if dir is 'r' and the right one if dir is 'l'.
+// The density matrix of each quantum number block is formed from the block of
+// t by ?syrk or ?herk and only its largest Dmax eigenpairs are solved.
+// The blocks are solved on thread_num threads, see ParallelForBlocks. The
+// truncation follows Svd. It falls back to BlockSvd if a kept eigenvalue is
+// below kDensMatSvdEigTol times the largest one, where the density matrix can
+// not resolve the singular values.
+template <typename TenElemType>
+SvdRes<TenElemType> DensMatSvd(
+    const GQTensor<TenElemType> &t,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const double cutoff, const long Dmin, const long Dmax,
+    const char dir,
+    const unsigned thread_num) {
+  using TenType = GQTensor<TenElemType>;
+  std::vector<long> laxes, raxes;
+  for (long i = 0; i < ldims; ++i) { laxes.push_back(i); }
+  for (long i = ldims; i < ldims+rdims; ++i) { raxes.push_back(i); }
+  bool kept_left = (dir == 'r');
+  auto &kept_axes = kept_left ? laxes : raxes;
+  std::vector<Index> kept_idxs;
+  for (auto axis : kept_axes) { kept_idxs.push_back(t.indexes[axis]); }
+
+  // The reduced density matrix of each block is formed from the block of t as
+  // a matrix, as mat mat^dag if the left side is kept or mat^dag mat.
+  auto blks = GenTenMatBlocks(t.indexes, ldims, rdims, ldiv, rdiv);
+  auto mats = GenDenseBlocks(t, blks);
+  long grps = blks.qns.size();
+  auto &kept_combos = kept_left ? blks.lcombos : blks.rcombos;
+  std::vector<double> costs(grps);
+  for (long g = 0; g < grps; ++g) {
+    double m = blks.lcombos[g].dim;
+    double n = blks.rcombos[g].dim;
+    costs[g] = kept_left ? m * m * (m + n) : n * n * (m + n);
+  }
+  std::vector<double> grp_traces(grps, 0.0);
+  std::vector<std::vector<double>> grp_eigvals(grps);
+  std::vector<std::vector<TenElemType>> grp_eigvecs(grps);
+  ParallelForBlocks(
+      costs, thread_num,
+      [&](const std::size_t g) {
+        long n = kept_combos[g].dim;
+        std::vector<TenElemType> mat;
+        MatGram(
+            mats[g], blks.lcombos[g].dim, blks.rcombos[g].dim,
+            kept_left, mat);
+        std::vector<TenElemType>().swap(mats[g]);
+        for (long i = 0; i < n; ++i) {
+          grp_traces[g] += std::abs(mat[i*n + i]);
+        }
+        long k = std::min(Dmax, n);
+        grp_eigvals[g].resize(k);
+        HermTopEigenSolver(mat, n, k, grp_eigvals[g].data(), grp_eigvecs[g]);
+      });
+  struct EigRef { double eigval; long grp; long k; };
+  std::vector<EigRef> eig_refs;
+  double tot = 0.0;
+  for (long g = 0; g < grps; ++g) {
+    tot += grp_traces[g];
+    for (long kk = 0; kk < (long)grp_eigvals[g].size(); ++kk) {
+      eig_refs.push_back({grp_eigvals[g][kk], g, kk});
+    }
+  }
+  std::stable_sort(
+      eig_refs.begin(), eig_refs.end(),
+      [](const EigRef &a, const EigRef &b) { return a.eigval > b.eigval; });
+
+  std::vector<double> weights;
+  for (auto &eig_ref : eig_refs) { weights.push_back(eig_ref.eigval); }
+  auto D = TruncDim(weights, tot, cutoff, Dmin, Dmax);
+  if (tot == 0.0 ||
+      eig_refs[D-1].eigval <= kDensMatSvdEigTol * eig_refs[0].eigval) {
+    return BlockSvd(
+               t, ldims, rdims, ldiv, rdiv,
+               cutoff, Dmin, Dmax,
+               thread_num);
+  }
+  double kept_weight = 0.0;
+  std::vector<std::vector<long>> grp_kept(grps);
+  for (long k = 0; k < D; ++k) {
+    kept_weight += eig_refs[k].eigval;
+    grp_kept[eig_refs[k].grp].push_back(eig_refs[k].k);
+  }
+
+  // Sectors of the new bond in the group order, each sorted by the eigenvalue.
+  std::vector<QNSector> qnscts;
+  for (long g = 0; g < grps; ++g) {
+    if (grp_kept[g].empty()) { continue; }
+    qnscts.push_back(QNSector(blks.qns[g], grp_kept[g].size()));
+  }
+  auto new_out = Index(qnscts, OUT);
+  auto new_in = InverseIndex(new_out);
+  std::vector<Index> iso_idxs;
+  if (kept_left) {
+    iso_idxs = kept_idxs;
+    iso_idxs.push_back(new_out);
+  } else {
+    iso_idxs.push_back(new_out);
+    for (auto &idx : kept_idxs) { iso_idxs.push_back(InverseIndex(idx)); }
+  }
+  // The kept isometry, u, or the conjugate of v.
+  auto iso = new TenType(iso_idxs);
+  auto s = new GQTensor<GQTEN_Double>({new_in, new_out});
+  auto inv_s = new TenType({new_in, new_out});
+  long offset = 0;
+  std::size_t sct = 0;
+  for (long g = 0; g < grps; ++g) {
+    if (grp_kept[g].empty()) { continue; }
+    long n = kept_combos[g].dim;
+    long k = grp_eigvals[g].size();
+    long kept = grp_kept[g].size();
+    SctCombos bond_combos;
+    bond_combos.scts.push_back({sct});
+    bond_combos.offsets.push_back(0);
+    bond_combos.dim = kept;
+    std::vector<TenElemType> iso_mat(n*kept);
+    for (long c = 0; c < kept; ++c) {
+      auto kk = grp_kept[g][c];
+      auto sval = std::sqrt(grp_eigvals[g][kk]);
+      (*s)({offset, offset}) = sval / std::sqrt(kept_weight);
+      (*inv_s)({offset, offset}) = 1.0 / sval;
+      for (long i = 0; i < n; ++i) {
+        if (kept_left) {
+          iso_mat[i*kept + c] = grp_eigvecs[g][i*k + kk];
+        } else {
+          iso_mat[c*n + i] = grp_eigvecs[g][i*k + kk];
+        }
+      }
+      ++offset;
+    }
+    if (kept_left) {
+      PutDenseBlock(iso, kept_combos[g], bond_combos, iso_mat.data());
+    } else {
+      PutDenseBlock(iso, bond_combos, kept_combos[g], iso_mat.data());
+    }
+    ++sct;
+  }
+
+  // The other side is the projection of t divided by the singular values.
+  SvdRes<TenElemType> svd_res;
+  if (kept_left) {
+    auto dag_u = Dag(*iso);
+    auto proj = Contract(dag_u, t, {laxes, laxes});
+    svd_res.u = iso;
+    svd_res.v = Contract(*inv_s, *proj, {{1}, {0}});
+    delete proj;
+  } else {
+    std::vector<long> iso_raxes;
+    for (long i = 1; i <= rdims; ++i) { iso_raxes.push_back(i); }
+    auto proj = Contract(t, *iso, {raxes, iso_raxes});
+    svd_res.u = Contract(*proj, *inv_s, {{ldims}, {0}});
+    svd_res.v = new TenType(Dag(*iso));
+    delete proj;
+    delete iso;
+  }
+  delete inv_s;
+  svd_res.s = s;
+  svd_res.trunc_err = std::max(tot - kept_weight, 0.0) / tot;
+  svd_res.D = D;
+  return svd_res;
+}
+
+
+// Truncated SVD of the two-site state, by DensMatSvd if DensMatTrunc is set
+// and by BlockSvd otherwise.
+template <typename TenElemType>
+SvdRes<TenElemType> TwoSiteTruncSvd(
+    const GQTensor<TenElemType> &state,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const SweepParams &sweep_params, const char dir) {
+  if (sweep_params.DensMatTrunc) {
+    return DensMatSvd(
+               state,
+               ldims, rdims,
+               ldiv, rdiv,
+               sweep_params.Cutoff,
+               sweep_params.Dmin, sweep_params.Dmax,
+               dir,
+               sweep_params.SvdThreadNum);
+  }
+  return BlockSvd(
+             state,
+             ldims, rdims,
+             ldiv, rdiv,
+             sweep_params.Cutoff,
+             sweep_params.Dmin, sweep_params.Dmax,
+             sweep_params.SvdThreadNum);
+}
+
+
+// Grow the left overlap environment, which ends at site-1, to site. The
+// legs are (projected state, current state).
+template <typename TenType>
+TenType *GenLeftOverlapEnv(
+    const TenType *lenv, const TenType &proj_mps_ten, const TenType &mps_ten,
+    const long site) {
+  if (site == 0) {
+    return Contract(proj_mps_ten, Dag(mps_ten), {{0}, {0}});
+  }
+  auto temp_lenv = Contract(*lenv, proj_mps_ten, {{0}, {0}});
+  auto new_lenv = Contract(*temp_lenv, Dag(mps_ten), {{0, 1}, {0, 1}});
+  delete temp_lenv;
+  return new_lenv;
+}
+
+
+// Grow the right overlap environment, which starts at site+1, to site.
+template <typename TenType>
+TenType *GenRightOverlapEnv(
+    const TenType *renv, const TenType &proj_mps_ten, const TenType &mps_ten,
+    const long site, const long N) {
+  if (site == N-1) {
+    return Contract(proj_mps_ten, Dag(mps_ten), {{1}, {1}});
+  }
+  auto temp_renv = Contract(proj_mps_ten, *renv, {{2}, {0}});
+  auto new_renv = Contract(*temp_renv, Dag(mps_ten), {{1, 2}, {1, 2}});
+  delete temp_renv;
+  return new_renv;
+}
+
+
+// The projected state on the two sites from lsite, shaped like the two-site
+// state of the current MPS.
+template <typename TenType>
+TenType *GenTwoSiteProjState(
+    const TenType *lenv, const TenType &proj_lmps_ten,
+    const TenType &proj_rmps_ten, const TenType *renv,
+    const std::string &where) {
+  TenType *proj_state;
+  if (where == "lend") {
+    proj_state = Contract(proj_lmps_ten, proj_rmps_ten, {{1}, {0}});
+    InplaceContract(proj_state, *renv, {{2}, {0}});
+  } else {
+    proj_state = Contract(*lenv, proj_lmps_ten, {{0}, {0}});
+    InplaceContract(proj_state, proj_rmps_ten, {{2}, {0}});
+    if (where == "cent") {
+      InplaceContract(proj_state, *renv, {{3}, {0}});
+    }
   }
+  return proj_state;
 }
 
 
@@ -60,54 +1697,251 @@ inline void RemoveFile(const std::string &file) {
 template <typename TenType>
 double TwoSiteAlgorithm(
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
-    const SweepParams &sweep_params) {
+    const SweepParams &sweep_params,
+    EntSpec *ent_spec) {
+  return TwoSiteAlgorithm(mps, mpo, sweep_params, {}, 0.0, ent_spec);
+}
+
+
+template <typename TenType>
+double TwoSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const std::vector<std::vector<TenType *>> &proj_mpss,
+    const double penalty_weight,
+    EntSpec *ent_spec) {
+  Targets<TenType> tgts;
+  return TwoSiteAlgorithmImpl(
+             mps, mpo, sweep_params,
+             proj_mpss, penalty_weight, tgts,
+             ent_spec);
+}
+
+
+template <typename TenType>
+std::vector<double> TwoSiteMultiTargetAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const long target_num,
+    std::vector<TenType *> &tgt_head_tens) {
+  assert(target_num >= 1);
+  if ((long)tgt_head_tens.size() != target_num-1) {
+    for (auto &head_ten : tgt_head_tens) { delete head_ten; }
+    tgt_head_tens.clear();
+    for (long i = 1; i < target_num; ++i) {
+      auto head_ten = new TenType(mps[0]->indexes);
+      head_ten->Random(Div(*mps[0]));
+      tgt_head_tens.push_back(head_ten);
+    }
+  }
+
+  Targets<TenType> tgts;
+  tgts.cent_tens = tgt_head_tens;
+  tgts.engs = std::vector<double>(target_num);
+  TwoSiteAlgorithmImpl(mps, mpo, sweep_params, {}, 0.0, tgts, nullptr);
+  tgt_head_tens = tgts.cent_tens;
+  return tgts.engs;
+}
+
+
+template <typename TenType>
+double TwoSiteAlgorithmImpl(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const std::vector<std::vector<TenType *>> &proj_mpss,
+    const double penalty_weight,
+    Targets<TenType> &tgts,
+    EntSpec *ent_spec) {
+  if (sweep_params.Distributed && !tgts.cent_tens.empty()) {
+    std::cout << "The distributed mode does not support the state-averaged "
+              << "algorithm" << std::endl;
+    exit(1);
+  }
+  if (
+      (sweep_params.LanczErrRatio > 0.0) &&
+      !sweep_params.LanczErrSchedule.empty()) {
+    std::cout << "The adaptive Lanczos error can not be used with "
+              << "LanczErrSchedule" << std::endl;
+    exit(1);
+  }
+  double e0 = 0.0;
+  if (
+      RealTwoSiteAlgorithmImpl(
+          mps, mpo, sweep_params,
+          proj_mpss, penalty_weight, tgts,
+          ent_spec,
+          e0)) {
+    return e0;
+  }
+
   if ( sweep_params.FileIO && !IsPathExist(kRuntimeTempPath)) {
     CreatPath(kRuntimeTempPath);
   }
 
-  auto l_and_r_blocks = InitBlocks(mps, mpo, sweep_params);
+  std::pair<std::vector<TenType *>, std::vector<TenType *>> l_and_r_blocks;
+  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
+    l_and_r_blocks = std::make_pair(
+                         std::vector<TenType *>(mps.size()-1),
+                         std::vector<TenType *>(mps.size()-1));
+  } else {
+    l_and_r_blocks = InitBlocks(
+                         mps, mpo,
+                         sweep_params.FileIO, sweep_params.Distributed);
+  }
+  if (ent_spec != nullptr) { *ent_spec = EntSpec(mps.size()-1); }
+  auto proj = InitProjStates(mps, proj_mpss, penalty_weight);
+  UpdateCache<TenType> cache;
+  BlockIo<TenType> io;
 
   std::cout << "\n";
-  double e0;
+  double max_trunc_err;
   Timer sweep_timer("sweep");
   for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
     std::cout << "sweep " << sweep << std::endl;
     sweep_timer.Restart();
+    auto e0_last = e0;
+    auto params = SweepParamsAt(sweep_params, sweep);
+    params.LanczParams.distributed = sweep_params.Distributed;
     e0 = TwoSiteSweep(
         mps, mpo,
         l_and_r_blocks.first, l_and_r_blocks.second,
-        sweep_params);
+        params,
+        ent_spec, proj, tgts, cache, io,
+        (sweep > 0) ? std::abs(e0 - e0_last) : HUGE_VAL,
+        max_trunc_err);
     sweep_timer.PrintElapsed();
     std::cout << "\n";
+    if (
+        (sweep > 0) &&
+        (std::abs(e0 - e0_last) < sweep_params.EnergyConvTol) &&
+        (max_trunc_err < sweep_params.TruncErrConvTol)) {
+      std::cout << "Converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
+  }
+  StopBlockIo(io);
+  FreeUpdateCache(cache);
+  for (auto &lenvs : proj.lenvs) {
+    for (auto &lenv : lenvs) { delete lenv; }
+  }
+  for (auto &renvs : proj.renvs) {
+    for (auto &renv : renvs) { delete renv; }
   }
   return e0;
 }
 
 
+// A complex MPO whose elements are real is swept in real if the sites of the
+// state, of the targets and of the projected states are real up to their
+// phases. The sites of the state and of the targets are replaced by their
+// real copies without the phases and are promoted back after the sweeps.
+// Nothing is done and false is returned if anything is not real, or if the
+// sweeps continue, since the blocks on disk are always complex: the real ones
+// are promoted on disk after the real sweeps.
+template <typename TenType>
+bool RealTwoSiteAlgorithmImpl(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const std::vector<std::vector<TenType *>> &proj_mpss,
+    const double penalty_weight,
+    Targets<TenType> &tgts,
+    EntSpec *ent_spec,
+    double &e0) {
+  using RealTenType = GQTensor<GQTEN_Double>;
+  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) { return false; }
+  std::vector<RealTenType *> real_mpo;
+  if (!GenRealTens(mpo, false, real_mpo)) { return false; }
+  std::vector<RealTenType *> real_mps;
+  Targets<RealTenType> real_tgts;
+  std::vector<std::vector<RealTenType *>> real_proj_mpss;
+  bool is_real = GenRealTens(mps, true, real_mps) &&
+                 GenRealTens(tgts.cent_tens, true, real_tgts.cent_tens);
+  for (auto &proj_mps : proj_mpss) {
+    if (!is_real) { break; }
+    std::vector<RealTenType *> real_proj_mps;
+    is_real = GenRealTens(proj_mps, true, real_proj_mps);
+    real_proj_mpss.push_back(real_proj_mps);
+  }
+  if (!is_real) {
+    for (auto &real_proj_mps : real_proj_mpss) {
+      for (auto &t : real_proj_mps) { delete t; }
+    }
+    for (auto &t : real_tgts.cent_tens) { delete t; }
+    for (auto &t : real_mps) { delete t; }
+    for (auto &t : real_mpo) { delete t; }
+    return false;
+  }
+  real_tgts.engs = tgts.engs;
+
+  std::cout << "\nThe MPO is real, sweep in real." << std::endl;
+  e0 = TwoSiteAlgorithmImpl(
+           real_mps, real_mpo, sweep_params,
+           real_proj_mpss, penalty_weight, real_tgts,
+           ent_spec);
+  if (sweep_params.FileIO) { PromoteBlockFiles<TenType>(mps.size()); }
+
+  for (std::size_t i = 0; i < mps.size(); ++i) {
+    delete mps[i];
+    mps[i] = GenPromotedTen<TenType>(*real_mps[i]);
+    delete real_mps[i];
+  }
+  for (std::size_t i = 0; i < tgts.cent_tens.size(); ++i) {
+    delete tgts.cent_tens[i];
+    tgts.cent_tens[i] = GenPromotedTen<TenType>(*real_tgts.cent_tens[i]);
+    delete real_tgts.cent_tens[i];
+  }
+  tgts.engs = real_tgts.engs;
+  for (auto &real_proj_mps : real_proj_mpss) {
+    for (auto &t : real_proj_mps) { delete t; }
+  }
+  for (auto &t : real_mpo) { delete t; }
+  return true;
+}
+
+
+// The overlap environments are initialized from the right, like the blocks.
+template <typename TenType>
+ProjStates<TenType> InitProjStates(
+    const std::vector<TenType *> &mps,
+    const std::vector<std::vector<TenType *>> &proj_mpss,
+    const double penalty_weight) {
+  auto N = mps.size();
+  ProjStates<TenType> proj;
+  proj.mpss = proj_mpss;
+  proj.weight = penalty_weight;
+  for (auto &proj_mps : proj_mpss) {
+    assert(proj_mps.size() == N);
+    std::vector<TenType *> renvs(N-1, nullptr);
+    for (size_t i = 1; i < N-1; ++i) {
+      renvs[i] = GenRightOverlapEnv(
+                     renvs[i-1], *proj_mps[N-i], *mps[N-i], N-i, N);
+    }
+    proj.lenvs.push_back(std::vector<TenType *>(N-1, nullptr));
+    proj.renvs.push_back(renvs);
+  }
+  return proj;
+}
+
+
 template<typename TenType>
 std::pair<std::vector<TenType *>, std::vector<TenType *>> InitBlocks(
     const std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
-    const SweepParams &sweep_params) {
+    const bool fileio, const bool distributed) {
   assert(mps.size() == mpo.size());
   auto N = mps.size();
   std::vector<TenType *> rblocks(N-1);
   std::vector<TenType *> lblocks(N-1);
 
-  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
-    return std::make_pair(lblocks, rblocks);
-  }
-
   // Generate blocks.
   // Right blocks.
   auto rblock0 = new TenType();
   rblocks[0] = rblock0;
-  auto rblock1 = Contract(*mps.back(), *mpo.back(), {{1}, {0}});
-  auto temp_rblock1 = Contract(*rblock1, Dag(*mps.back()), {{2}, {1}});
-  delete rblock1;
-  rblock1 = temp_rblock1;
+  auto rblock1 = distributed ?
+                 DistGenRightBlock(rblock0, *mps.back(), *mpo.back(), N-1, N) :
+                 GenRightBlock(rblock0, *mps.back(), *mpo.back(), N-1, N);
   rblocks[1] = rblock1;
   std::string file;
-  if (sweep_params.FileIO) {
+  if (fileio) {
     file = GenBlockFileName("r", 0);
     WriteGQTensorTOFile(*rblock0, file);
     delete rblocks[0];
@@ -115,24 +1949,21 @@ std::pair<std::vector<TenType *>, std::vector<TenType *>> InitBlocks(
     WriteGQTensorTOFile(*rblock1, file);
   }
   for (size_t i = 2; i < N-1; ++i) {
-    auto rblocki = Contract(*mps[N-i], *rblocks[i-1], {{2}, {0}});
-    auto temp_rblocki = Contract(*rblocki, *mpo[N-i], {{1, 2}, {1, 3}});
-    delete rblocki;
-    rblocki = temp_rblocki;
-    temp_rblocki = Contract(*rblocki, Dag(*mps[N-i]), {{3, 1}, {1, 2}});
-    delete rblocki;
-    rblocki = temp_rblocki;
+    auto rblocki = distributed ?
+                   DistGenRightBlock(
+                       rblocks[i-1], *mps[N-i], *mpo[N-i], N-i, N) :
+                   GenRightBlock(rblocks[i-1], *mps[N-i], *mpo[N-i], N-i, N);
     rblocks[i] = rblocki;
-    if (sweep_params.FileIO) {
+    if (fileio) {
       auto file = GenBlockFileName("r", i);
       WriteGQTensorTOFile(*rblocki, file);
       delete rblocks[i-1];
     }
   }
-  if (sweep_params.FileIO) { delete rblocks[N-2]; }
+  if (fileio) { delete rblocks[N-2]; }
 
   // Left blocks.
-  if (sweep_params.FileIO) {
+  if (fileio) {
     auto file = GenBlockFileName("l", 0);
     WriteGQTensorTOFile(TenType(), file);
   }
@@ -145,14 +1976,39 @@ template <typename TenType>
 double TwoSiteSweep(
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
     std::vector<TenType *> &lblocks, std::vector<TenType *> &rblocks,
-    const SweepParams &sweep_params) {
+    const SweepParams &sweep_params,
+    EntSpec *ent_spec, ProjStates<TenType> &proj, Targets<TenType> &tgts,
+    UpdateCache<TenType> &cache, BlockIo<TenType> &io,
+    const double sweep_eng_diff, double &max_trunc_err) {
   auto N = mps.size();
   double e0;
+  double trunc_err = 0.0;
+  max_trunc_err = 0.0;
+  auto update_params = sweep_params;
+  bool adaptive_lancz_err = (sweep_params.LanczErrRatio > 0.0);
   for (size_t i = 0; i < N-1; ++i) {
-    e0 = TwoSiteUpdate(i, mps, mpo, lblocks, rblocks, sweep_params, 'r');
+    if (adaptive_lancz_err) {
+      update_params.LanczParams.error = AdaptiveLanczErr(
+                                            sweep_params,
+                                            trunc_err, sweep_eng_diff);
+    }
+    e0 = TwoSiteUpdate(
+             i, mps, mpo, lblocks, rblocks, update_params, 'r',
+             ent_spec, proj, tgts, cache, io,
+             trunc_err, std::cout);
+    max_trunc_err = std::max(max_trunc_err, trunc_err);
   }
   for (size_t i = N-1; i > 0; --i) {
-    e0 = TwoSiteUpdate(i, mps, mpo, lblocks, rblocks, sweep_params, 'l');
+    if (adaptive_lancz_err) {
+      update_params.LanczParams.error = AdaptiveLanczErr(
+                                            sweep_params,
+                                            trunc_err, sweep_eng_diff);
+    }
+    e0 = TwoSiteUpdate(
+             i, mps, mpo, lblocks, rblocks, update_params, 'l',
+             ent_spec, proj, tgts, cache, io,
+             trunc_err, std::cout);
+    max_trunc_err = std::max(max_trunc_err, trunc_err);
   }
   return e0;
 }
@@ -163,7 +2019,10 @@ double TwoSiteUpdate(
     const long i,
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
     std::vector<TenType *> &lblocks, std::vector<TenType *> &rblocks,
-    const SweepParams &sweep_params, const char dir) {
+    const SweepParams &sweep_params, const char dir,
+    EntSpec *ent_spec, ProjStates<TenType> &proj, Targets<TenType> &tgts,
+    UpdateCache<TenType> &cache, BlockIo<TenType> &io,
+    double &trunc_err, std::ostream &out) {
   Timer update_timer("update");
   update_timer.Restart();
 
@@ -172,7 +2031,7 @@ double TwoSiteUpdate(
   bef_lanc_timer.Restart();
 #endif
 
-  auto N = mps.size();
+  long N = mps.size();
   std::vector<std::vector<long>> init_state_ctrct_axes, us_ctrct_axes;
   std::string where;
   long svd_ldims, svd_rdims;
@@ -233,20 +2092,24 @@ double TwoSiteUpdate(
       exit(1);
   }
 
+  // The block of the next update in the same direction is read during this
+  // one, and the new block is dumped during the next one.
   if (sweep_params.FileIO) {
     switch (dir) {
       case 'r':
         rblock_file = GenBlockFileName("r", rblock_len);
-        ReadGQTensorFromFile(rblocks[rblock_len], rblock_file);
+        rblocks[rblock_len] = TakeBlock(io, rblock_file);
         if (rblock_len != 0) {
-          RemoveFile(rblock_file);
+          RemoveBlockFile(io, rblock_file);
+          PrefetchBlock(io, GenBlockFileName("r", rblock_len-1));
         }
         break;
       case 'l':
         lblock_file = GenBlockFileName("l", lblock_len);
-        ReadGQTensorFromFile(lblocks[lblock_len], lblock_file);
+        lblocks[lblock_len] = TakeBlock(io, lblock_file);
         if (lblock_len != 0) {
-          RemoveFile(lblock_file);
+          RemoveBlockFile(io, lblock_file);
+          PrefetchBlock(io, GenBlockFileName("l", lblock_len-1));
         }
         break;
       default:
@@ -265,17 +2128,64 @@ double TwoSiteUpdate(
   eff_ham[1] = mpo[lsite_idx];
   eff_ham[2] = mpo[rsite_idx];
   eff_ham[3] = rblocks[rblock_len];
-  auto init_state = Contract(
-                        *mps[lsite_idx], *mps[rsite_idx],
-                        init_state_ctrct_axes);
+  // The blocks are the slices of the rank in the distributed mode.
+  auto solve_ham = sweep_params.Distributed ?
+                   GenDistEffHam(eff_ham, where) : eff_ham;
 
   Timer lancz_timer("Lancz");
   lancz_timer.Restart();
 
-  auto lancz_res = LanczosSolver(
-                       eff_ham, init_state,
-                       sweep_params.LanczParams,
-                       where);
+  // The targets of the state-averaged algorithm are stacked along the leg
+  // which is truncated away.
+  std::vector<TenType *> tgt_states;
+  long ext_leg = (dir == 'r') ? (svd_ldims + svd_rdims - 1) : 0;
+  auto lancz_res = TakeUpdateCache(
+                       cache, lsite_idx, sweep_params.LanczParams.error,
+                       !tgts.cent_tens.empty(), ext_leg,
+                       tgt_states, tgts.engs);
+  if (lancz_res.gs_vec == nullptr) {
+    auto init_state = Contract(
+                          *mps[lsite_idx], *mps[rsite_idx],
+                          init_state_ctrct_axes);
+    std::vector<TenType *> penalty_states;
+    for (size_t k = 0; k < proj.mpss.size(); ++k) {
+      penalty_states.push_back(
+          GenTwoSiteProjState(
+              proj.lenvs[k][lblock_len],
+              *proj.mpss[k][lsite_idx], *proj.mpss[k][rsite_idx],
+              proj.renvs[k][rblock_len],
+              where));
+    }
+    std::vector<TenType *> init_states = {init_state};
+    for (auto &cent_ten : tgts.cent_tens) {
+      if (dir == 'r') {
+        init_states.push_back(
+            Contract(*cent_ten, *mps[rsite_idx], init_state_ctrct_axes));
+      } else {
+        init_states.push_back(
+            Contract(*mps[lsite_idx], *cent_ten, init_state_ctrct_axes));
+      }
+    }
+    lancz_res = tgts.cent_tens.empty() ?
+                LanczosSolver(
+                    solve_ham, init_state,
+                    sweep_params.LanczParams,
+                    where,
+                    penalty_states, proj.weight) :
+                StateAvgLanczosSolver(
+                    solve_ham, init_states,
+                    sweep_params.LanczParams,
+                    where,
+                    penalty_states, proj.weight,
+                    ext_leg, tgt_states, tgts.engs);
+    for (auto &penalty_state : penalty_states) { delete penalty_state; }
+  }
+  // The chain end is solved again right after the sweep direction reverses.
+  if ((dir == 'r' && i == (long)N-2) || (dir == 'l' && i == 1)) {
+    SaveUpdateCache(
+        cache, lsite_idx, sweep_params.LanczParams.error,
+        lancz_res.gs_eng, lancz_res.gs_vec, tgt_states, tgts.engs);
+  }
 
 #ifdef GQMPS2_TIMING_MODE
   auto lancz_elapsed_time = lancz_timer.PrintElapsed();
@@ -289,21 +2199,49 @@ double TwoSiteUpdate(
   svd_timer.Restart();
 #endif
 
-  auto svd_res = Svd(
-      *lancz_res.gs_vec,
-      svd_ldims, svd_rdims,
-      Div(*mps[lsite_idx]), Div(*mps[rsite_idx]),
-      sweep_params.Cutoff,
-      sweep_params.Dmin, sweep_params.Dmax);
+  // With the noise, the perturbed state is truncated and the centers are
+  // moved through its kept singular vectors like the targets. The truncation
+  // error is the weight of the unperturbed state outside the kept subspace,
+  // 1 - ||U^dag psi||^2, taken when the center is moved. The entanglement is
+  // of the kept singular values of the perturbed state.
+  auto svd_state = lancz_res.gs_vec;
+  if (sweep_params.Noise > 0.0) {
+    svd_state = GenNoisePerturbedState(
+                    eff_ham, *lancz_res.gs_vec,
+                    where, dir,
+                    sweep_params.Noise, sweep_params.Distributed);
+  }
+  auto svd_res = TwoSiteTruncSvd(
+                     *svd_state,
+                     svd_ldims, svd_rdims,
+                     Div(*mps[lsite_idx]), Div(*mps[rsite_idx]),
+                     sweep_params, dir);
+  if (sweep_params.Noise > 0.0) {
+    delete svd_state;
+    if (tgt_states.empty()) {
+      tgt_states.push_back(lancz_res.gs_vec);
+    } else {
+      delete lancz_res.gs_vec;
+    }
+  } else {
+    delete svd_state;
+  }
 
 #ifdef GQMPS2_TIMING_MODE
   svd_timer.PrintElapsed();
 #endif
 
-  delete lancz_res.gs_vec;
+  if (sweep_params.Distributed) {
+    delete solve_ham[1];
+    delete solve_ham[2];
+  }
 
   // Measure entanglement entropy.
+  trunc_err = svd_res.trunc_err;
   auto ee = MeasureEE(svd_res.s, svd_res.D);
+  if (ent_spec != nullptr) {
+    (*ent_spec)[lsite_idx] = GenBondEntSpec(*svd_res.s);
+  }
 
   // Update MPS sites and blocks.
 #ifdef GQMPS2_TIMING_MODE
@@ -325,25 +2263,30 @@ double TwoSiteUpdate(
       delete mps[lsite_idx];
       mps[lsite_idx] = svd_res.u;
       delete mps[rsite_idx];
-      mps[rsite_idx] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      if (tgt_states.empty()) {
+        mps[rsite_idx] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      } else {
+        auto kept_weight = MoveTargetCents(
+                               tgt_states, *svd_res.u, dir,
+                               svd_ldims, svd_rdims,
+                               mps[rsite_idx], tgts.cent_tens);
+        if (sweep_params.Noise > 0.0) {
+          trunc_err = std::max(1.0 - kept_weight, 0.0);
+        }
+      }
       delete svd_res.s;
       delete svd_res.v;
 
-      if (i == 0) {
-        new_lblock = Contract(*mps[i], *mpo[i], {{0}, {0}});
-        auto temp_new_lblock = Contract(
-                                   *new_lblock, Dag(*mps[i]),
-                                   {{2}, {0}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
-      } else if (i != N-2) {
-        new_lblock = Contract(*lblocks[i], *mps[i], {{0}, {0}});
-        auto temp_new_lblock = Contract(*new_lblock, *mpo[i], {{0, 2}, {0, 1}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
-        temp_new_lblock = Contract(*new_lblock, Dag(*mps[i]), {{0, 2}, {0, 1}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
+      if (i != N-2) {
+        new_lblock = sweep_params.Distributed ?
+                     DistGenLeftBlock(lblocks[i], *mps[i], *mpo[i], i) :
+                     GenLeftBlock(lblocks[i], *mps[i], *mpo[i], i);
+        for (size_t k = 0; k < proj.mpss.size(); ++k) {
+          delete proj.lenvs[k][i+1];
+          proj.lenvs[k][i+1] = GenLeftOverlapEnv(
+                                   proj.lenvs[k][i], *proj.mpss[k][i],
+                                   *mps[i], i);
+        }
       } else {
         update_block = false;
       }
@@ -354,11 +2297,13 @@ double TwoSiteUpdate(
 #endif
 
       if (sweep_params.FileIO) {
+        // The old block may be still in its dump.
+        WaitBlockIo(io);
         if (update_block) {
           auto target_blk_len = i+1;
           lblocks[target_blk_len] = new_lblock;
           auto target_blk_file = GenBlockFileName("l", target_blk_len);
-          WriteGQTensorTOFile(*new_lblock, target_blk_file);
+          DumpBlock(io, new_lblock, target_blk_file);
           delete eff_ham[0];
           delete eff_ham[3];
         } else {
@@ -384,25 +2329,32 @@ double TwoSiteUpdate(
 #endif
 
       delete mps[lsite_idx];
-      mps[lsite_idx] = Contract(*svd_res.u, *svd_res.s, us_ctrct_axes);
+      if (tgt_states.empty()) {
+        mps[lsite_idx] = Contract(*svd_res.u, *svd_res.s, us_ctrct_axes);
+      } else {
+        auto kept_weight = MoveTargetCents(
+                               tgt_states, *svd_res.v, dir,
+                               svd_ldims, svd_rdims,
+                               mps[lsite_idx], tgts.cent_tens);
+        if (sweep_params.Noise > 0.0) {
+          trunc_err = std::max(1.0 - kept_weight, 0.0);
+        }
+      }
       delete svd_res.u;
       delete svd_res.s;
       delete mps[rsite_idx];
       mps[rsite_idx] = svd_res.v;
 
-      if (i == N-1) {
-        new_rblock = Contract(*mps[i], *mpo[i], {{1}, {0}});
-        auto temp_new_rblock = Contract(*new_rblock, Dag(*mps[i]), {{2}, {1}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
-      } else if (i != 1) {
-        new_rblock = Contract(*mps[i], *eff_ham[3], {{2}, {0}});
-        auto temp_new_rblock = Contract(*new_rblock, *mpo[i], {{1, 2}, {1, 3}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
-        temp_new_rblock = Contract(*new_rblock, Dag(*mps[i]), {{3, 1}, {1, 2}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
+      if (i != 1) {
+        new_rblock = sweep_params.Distributed ?
+                     DistGenRightBlock(eff_ham[3], *mps[i], *mpo[i], i, N) :
+                     GenRightBlock(eff_ham[3], *mps[i], *mpo[i], i, N);
+        for (size_t k = 0; k < proj.mpss.size(); ++k) {
+          delete proj.renvs[k][N-i];
+          proj.renvs[k][N-i] = GenRightOverlapEnv(
+                                   proj.renvs[k][N-i-1], *proj.mpss[k][i],
+                                   *mps[i], i, N);
+        }
       } else {
         update_block = false;
       }
@@ -413,11 +2365,13 @@ double TwoSiteUpdate(
 #endif
 
       if (sweep_params.FileIO) {
+        // The old block may be still in its dump.
+        WaitBlockIo(io);
         if (update_block) {
           auto target_blk_len = N-i;
           rblocks[target_blk_len] = new_rblock;
           auto target_blk_file = GenBlockFileName("r", target_blk_len);
-          WriteGQTensorTOFile(*new_rblock, target_blk_file);
+          DumpBlock(io, new_rblock, target_blk_file);
           delete eff_ham[0];
           delete eff_ham[3];
         } else {
@@ -442,15 +2396,401 @@ double TwoSiteUpdate(
 #endif
 
   auto update_elapsed_time = update_timer.Elapsed();
-  std::cout << "Site " << std::setw(4) << i
+  out << "Site " << std::setw(4) << i
             << " E0 = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << lancz_res.gs_eng
-            << " TruncErr = " << std::setprecision(2) << std::scientific << svd_res.trunc_err << std::fixed
+            << " TruncErr = " << std::setprecision(2) << std::scientific << trunc_err << std::fixed
             << " D = " << std::setw(5) << svd_res.D
             << " Iter = " << std::setw(3) << lancz_res.iters
             << " LanczT = " << std::setw(8) << lancz_elapsed_time
             << " TotT = " << std::setw(8) << update_elapsed_time
             << " S = " << std::setw(10) << std::setprecision(7) << ee;
-  std::cout << std::scientific << std::endl;
+  out << std::scientific << std::endl;
+  return lancz_res.gs_eng;
+}
+
+
+// Infinite DMRG warm-up
+template <typename TenType>
+double InfiniteWarmUp(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const std::vector<long> &stat_labs, const Index &pb_out) {
+  auto N = mps.size();
+  assert(mpo.size() == N);
+  assert(stat_labs.size() == N);
+  if (N < 4 || N % 2 != 0) {
+    std::cout << "The warm-up needs an even N of at least 4, but N = "
+              << N << std::endl;
+    exit(1);
+  }
+  for (size_t k = 1; k < N/2-1; ++k) {
+    if (!(mpo[k]->indexes.back() == InverseIndex(mpo[N-1-k]->indexes[0]))) {
+      std::cout << "The MPO bond of site " << k
+                << " does not match the one of site " << N-1-k << std::endl;
+      exit(1);
+    }
+  }
+  for (auto &mps_ten : mps) { delete mps_ten; }
+  std::vector<QN> qns;
+  for (auto stat_lab : stat_labs) {
+    qns.push_back(pb_out.CoorInterOffsetAndQnsct(stat_lab).qnsct.qn);
+  }
+  auto zero_div = qns[0] - qns[0];
+
+  // The end sites keep all their states.
+  auto end_state = new TenType({pb_out, pb_out});
+  end_state->Random(qns[0] + qns[N-1]);
+  auto end_svd_res = BlockSvd(
+                         *end_state, 1, 1, Div(*end_state), zero_div,
+                         0.0, pb_out.dim, pb_out.dim, 1);
+  delete end_state;
+  delete end_svd_res.s;
+  mps[0] = end_svd_res.u;
+  mps[N-1] = end_svd_res.v;
+
+  std::cout << "\n";
+  TenType *lblock = nullptr;
+  std::vector<TenType *> rblocks(N-1);
+  rblocks[0] = new TenType();
+  double e0 = 0.0;
+  for (size_t k = 1; k < N/2; ++k) {
+    Timer update_timer("update");
+    update_timer.Restart();
+    auto new_lblock = GenLeftBlock(lblock, *mps[k-1], *mpo[k-1], k-1);
+    delete lblock;
+    lblock = new_lblock;
+    rblocks[k] = GenRightBlock(rblocks[k-1], *mps[N-k], *mpo[N-k], N-k, N);
+
+    std::vector<TenType *> eff_ham = {lblock, mpo[k], mpo[N-1-k], rblocks[k]};
+    auto init_state = new TenType({
+                          InverseIndex(mps[k-1]->indexes.back()),
+                          pb_out, pb_out,
+                          InverseIndex(mps[N-k]->indexes[0])});
+    init_state->Random(qns[k] + qns[N-1-k]);
+    auto lancz_res = LanczosSolver(
+                         eff_ham, init_state,
+                         sweep_params.LanczParams,
+                         "cent");
+    auto svd_res = BlockSvd(
+                       *lancz_res.gs_vec, 2, 2,
+                       Div(*lancz_res.gs_vec), zero_div,
+                       sweep_params.Cutoff,
+                       sweep_params.Dmin, sweep_params.Dmax,
+                       sweep_params.SvdThreadNum);
+    delete lancz_res.gs_vec;
+    e0 = lancz_res.gs_eng;
+    auto ee = MeasureEE(svd_res.s, svd_res.D);
+
+    if (k == N/2-1) {
+      mps[k] = Contract(*svd_res.u, *svd_res.s, {{2}, {0}});
+      delete svd_res.u;
+    } else {
+      mps[k] = svd_res.u;
+    }
+    mps[N-1-k] = svd_res.v;
+    delete svd_res.s;
+
+    std::cout << "Warm-up N = " << std::setw(5) << 2*k+2
+              << " E0 = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << e0
+              << " TruncErr = " << std::setprecision(2) << std::scientific << svd_res.trunc_err << std::fixed
+              << " D = " << std::setw(5) << svd_res.D
+              << " Iter = " << std::setw(3) << lancz_res.iters
+              << " TotT = " << std::setw(8) << update_timer.Elapsed()
+              << " S = " << std::setw(10) << std::setprecision(7) << ee;
+    std::cout << std::scientific << std::endl;
+  }
+  delete lblock;
+
+  // Move the center to site 0, where the sweeps start.
+  auto temp_mps = MPS<TenType>(mps, N/2-1);
+  RightNormalizeMps(temp_mps, N/2-1, 1, sweep_params.SvdThreadNum);
+
+  if (sweep_params.FileIO) {
+    if (!IsPathExist(kRuntimeTempPath)) { CreatPath(kRuntimeTempPath); }
+    for (size_t i = N/2; i < N-1; ++i) {
+      rblocks[i] = GenRightBlock(rblocks[i-1], *mps[N-i], *mpo[N-i], N-i, N);
+    }
+    for (size_t i = 0; i < N-1; ++i) {
+      WriteGQTensorTOFile(*rblocks[i], GenBlockFileName("r", i));
+    }
+    WriteGQTensorTOFile(TenType(), GenBlockFileName("l", 0));
+  }
+  for (auto &rblock : rblocks) { delete rblock; }
+  return e0;
+}
+
+
+// Real-space parallel DMRG. The segments are swept on their own threads
+// between the blocks of their ends, in opposite directions for neighbouring
+// segments, so that the centers of two neighbours meet at every other
+// boundary after each half sweep. The two sites of such a boundary are then
+// solved with the inverse of its singular values in between, which glues the
+// neighbours, and the blocks across it are renewed.
+template <typename TenType>
+double ParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, const long seg_num) {
+  long N = mps.size();
+  assert(mpo.size() == mps.size());
+  if (seg_num < 1 || N < 2*seg_num) {
+    std::cout << "Each of the " << seg_num
+              << " segments needs at least 2 sites, but N = " << N
+              << std::endl;
+    exit(1);
+  }
+  std::vector<long> seg_begs(seg_num), seg_ends(seg_num);
+  for (long k = 0; k < seg_num; ++k) {
+    seg_begs[k] = k * N / seg_num;
+    seg_ends[k] = (k+1) * N / seg_num - 1;
+  }
+
+  auto l_and_r_blocks = InitBlocks(mps, mpo, false);
+  auto &lblocks = l_and_r_blocks.first;
+  auto &rblocks = l_and_r_blocks.second;
+  auto bond_invs = InitParallelSegments(
+                       mps, mpo, seg_begs, seg_ends, lblocks,
+                       sweep_params.SvdThreadNum);
+  std::vector<UpdateCache<TenType>> caches(seg_num);
+
+  std::cout << "\n";
+  double e0 = 0.0;
+  Timer sweep_timer("sweep");
+  for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
+    std::cout << "sweep " << sweep << std::endl;
+    sweep_timer.Restart();
+    auto update_params = SweepParamsAt(sweep_params, sweep);
+    update_params.FileIO = false;
+    update_params.Distributed = false;
+    // The segments already take the threads.
+    update_params.SvdThreadNum = 1;
+    auto e0_last = e0;
+    std::vector<double> seg_engs(seg_num);
+    std::vector<double> seg_trunc_errs(seg_num, 0.0);
+    std::vector<double> bond_engs;
+    // The segments of even k sweep to the right in the first half sweep and
+    // to the left in the second, the others the other way around.
+    for (long half = 0; half < 2; ++half) {
+      // The updates are logged per thread and printed in order afterwards.
+      std::vector<std::ostringstream> seg_logs(seg_num);
+      ParallelFor(
+          seg_num, seg_num,
+          [&](const std::size_t k) {
+            mkl_set_num_threads_local(1);
+            auto proj = InitProjStates(
+                            mps, std::vector<std::vector<TenType *>>(), 0.0);
+            Targets<TenType> tgts;
+            // The blocks are kept in memory, so no block file task is pushed.
+            BlockIo<TenType> io;
+            double trunc_err = 0.0;
+            if ((k + half) % 2 == 0) {
+              for (long i = seg_begs[k]; i < seg_ends[k]; ++i) {
+                seg_engs[k] = TwoSiteUpdate(
+                                  i, mps, mpo, lblocks, rblocks,
+                                  update_params, 'r',
+                                  nullptr, proj, tgts, caches[k], io,
+                                  trunc_err, seg_logs[k]);
+                seg_trunc_errs[k] = std::max(seg_trunc_errs[k], trunc_err);
+              }
+            } else {
+              for (long i = seg_ends[k]; i > seg_begs[k]; --i) {
+                seg_engs[k] = TwoSiteUpdate(
+                                  i, mps, mpo, lblocks, rblocks,
+                                  update_params, 'l',
+                                  nullptr, proj, tgts, caches[k], io,
+                                  trunc_err, seg_logs[k]);
+                seg_trunc_errs[k] = std::max(seg_trunc_errs[k], trunc_err);
+              }
+            }
+            mkl_set_num_threads_local(0);
+          });
+      for (auto &log : seg_logs) { std::cout << log.str(); }
+      std::vector<long> bonds;
+      for (long k = half; k < seg_num-1; k += 2) { bonds.push_back(k); }
+      std::vector<double> engs(bonds.size());
+      std::vector<std::ostringstream> bond_logs(bonds.size());
+      ParallelFor(
+          bonds.size(), bonds.size(),
+          [&](const std::size_t j) {
+            mkl_set_num_threads_local(1);
+            auto k = bonds[j];
+            engs[j] = ParallelBoundaryUpdate(
+                          seg_ends[k], mps, mpo, lblocks, rblocks,
+                          bond_invs[k], update_params, bond_logs[j]);
+            mkl_set_num_threads_local(0);
+          });
+      for (auto &log : bond_logs) { std::cout << log.str(); }
+      bond_engs.insert(bond_engs.end(), engs.begin(), engs.end());
+    }
+    if (bond_engs.empty()) {
+      e0 = seg_engs[0];
+    } else {
+      e0 = std::accumulate(bond_engs.begin(), bond_engs.end(), 0.0) /
+           bond_engs.size();
+    }
+    auto max_trunc_err = *std::max_element(
+                             seg_trunc_errs.begin(), seg_trunc_errs.end());
+    sweep_timer.PrintElapsed();
+    std::cout << "\n";
+    if (
+        (sweep > 0) &&
+        (std::abs(e0 - e0_last) < sweep_params.EnergyConvTol) &&
+        (max_trunc_err < sweep_params.TruncErrConvTol)) {
+      std::cout << "Converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
+  }
+  for (auto &cache : caches) { FreeUpdateCache(cache); }
+  for (auto &lblock : lblocks) { delete lblock; }
+  for (auto &rblock : rblocks) { delete rblock; }
+
+  // Glue the segments back into one MPS centered at site 0.
+  for (long k = 0; k < seg_num-1; ++k) {
+    auto site = Contract(*mps[seg_ends[k]], *bond_invs[k], {{2}, {0}});
+    delete mps[seg_ends[k]];
+    mps[seg_ends[k]] = site;
+    delete bond_invs[k];
+  }
+  auto temp_mps = MPS<TenType>(mps, N-1);
+  RightNormalizeMps(temp_mps, N-1, 1, sweep_params.SvdThreadNum);
+  return e0;
+}
+
+
+// Bring the MPS, centered at site 0, to the starting form of the parallel
+// sweeps by an untruncated sweep to the right. The segments of even k are
+// centered at their first site and the others at their last site, and the
+// boundaries carry the inverses of their bond matrices. The left blocks are
+// generated from the left canonical sites, the right blocks of the right
+// canonical MPS are kept.
+template <typename TenType>
+std::vector<TenType *> InitParallelSegments(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const std::vector<long> &seg_begs, const std::vector<long> &seg_ends,
+    std::vector<TenType *> &lblocks,
+    const unsigned thread_num) {
+  long N = mps.size();
+  long seg_num = seg_ends.size();
+  std::vector<TenType *> bond_invs(seg_num-1);
+  auto cent = new TenType(*mps[0]);
+  long k = 0;
+  for (long i = 0; i < N-1; ++i) {
+    if (i > seg_ends[k]) { ++k; }
+    if (
+        (k % 2 == 0 && i == seg_begs[k]) ||
+        (k % 2 == 1 && i == seg_ends[k])) {
+      delete mps[i];
+      mps[i] = new TenType(*cent);
+    }
+    auto zero_div = Div(*cent) - Div(*cent);
+    long D = cent->indexes.back().dim;
+    auto svd_res = BlockSvd(
+                       *cent, (i == 0) ? 1 : 2, 1,
+                       Div(*cent), zero_div,
+                       0.0, D, D, thread_num);
+    delete cent;
+    if (i < N-2) {
+      lblocks[i+1] = GenLeftBlock(lblocks[i], *svd_res.u, *mpo[i], i);
+    }
+    if (i == seg_ends[k]) {
+      auto s_inv = GenInvSvals(*svd_res.s);
+      bond_invs[k] = Contract(Dag(*svd_res.v), *s_inv, {{0}, {0}});
+      delete s_inv;
+    }
+    if (k % 2 == 1 && i < seg_ends[k]) {
+      delete mps[i];
+      mps[i] = svd_res.u;
+    } else {
+      delete svd_res.u;
+    }
+    auto bond = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    delete svd_res.s;
+    delete svd_res.v;
+    cent = Contract(*bond, *mps[i+1], {{1}, {0}});
+    delete bond;
+  }
+  if (k % 2 == 1) {
+    delete mps[N-1];
+    mps[N-1] = cent;
+  } else {
+    delete cent;
+  }
+  return bond_invs;
+}
+
+
+// Solve the two sites of the boundary between site e and e+1. Their centers
+// are glued by the inverse singular values bond_inv, which is renewed, and
+// the blocks across the boundary are regenerated. The update is logged to
+// out.
+template <typename TenType>
+double ParallelBoundaryUpdate(
+    const long e,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    std::vector<TenType *> &lblocks, std::vector<TenType *> &rblocks,
+    TenType *&bond_inv,
+    const SweepParams &sweep_params, std::ostream &out) {
+  Timer update_timer("update");
+  update_timer.Restart();
+  long N = mps.size();
+  auto s = e + 1;
+  auto temp = Contract(*mps[e], *bond_inv, {{2}, {0}});
+  auto init_state = Contract(*temp, *mps[s], {{2}, {0}});
+  delete temp;
+  std::vector<TenType *> eff_ham = {lblocks[e], mpo[e], mpo[s], rblocks[N-1-s]};
+  auto lancz_res = LanczosSolver(
+                       eff_ham, init_state,
+                       sweep_params.LanczParams,
+                       (s == N-1) ? "rend" : "cent");
+  auto svd_res = BlockSvd(
+                     *lancz_res.gs_vec, 2, (s == N-1) ? 1 : 2,
+                     Div(*mps[e]), Div(*mps[s]),
+                     sweep_params.Cutoff,
+                     sweep_params.Dmin, sweep_params.Dmax,
+                     sweep_params.SvdThreadNum);
+  delete lancz_res.gs_vec;
+  auto ee = MeasureEE(svd_res.s, svd_res.D);
+
+  if (s < N-1) {
+    delete lblocks[s];
+    lblocks[s] = GenLeftBlock(lblocks[e], *svd_res.u, *mpo[e], e);
+  }
+  delete rblocks[N-1-e];
+  rblocks[N-1-e] = GenRightBlock(rblocks[N-1-s], *svd_res.v, *mpo[s], s, N);
+  delete mps[e];
+  delete mps[s];
+  mps[e] = Contract(*svd_res.u, *svd_res.s, {{2}, {0}});
+  mps[s] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+  auto s_inv = GenInvSvals(*svd_res.s);
+  delete bond_inv;
+  bond_inv = GenPromotedTen<TenType>(*s_inv);
+  delete s_inv;
+  delete svd_res.u;
+  delete svd_res.s;
+  delete svd_res.v;
+
+  out << "Bond " << std::setw(4) << e
+            << " E0 = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << lancz_res.gs_eng
+            << " TruncErr = " << std::setprecision(2) << std::scientific << svd_res.trunc_err << std::fixed
+            << " D = " << std::setw(5) << svd_res.D
+            << " Iter = " << std::setw(3) << lancz_res.iters
+            << " TotT = " << std::setw(8) << update_timer.Elapsed()
+            << " S = " << std::setw(10) << std::setprecision(7) << ee;
+  out << std::scientific << std::endl;
   return lancz_res.gs_eng;
 }
-} /* gqmps2 */ 
+
+
+// Regularized inverse of the singular values, s / (s^2 + eps), which sits
+// between the u s and s v of the decomposition.
+inline GQTensor<GQTEN_Double> *GenInvSvals(const GQTensor<GQTEN_Double> &s) {
+  auto s_inv = new GQTensor<GQTEN_Double>({
+                   InverseIndex(s.indexes[1]), InverseIndex(s.indexes[0])});
+  for (long i = 0; i < s.indexes[0].dim; ++i) {
+    auto sval = s.Elem({i, i});
+    if (sval != 0.0) {
+      (*s_inv)({i, i}) = sval / (sval * sval + kParallelInvSvalEps);
+    }
+  }
+  return s_inv;
+}
+} /* gqmps2 */
@@ -15,9 +15,16 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <cerrno>
 
 #include <sys/stat.h>
 
+#ifdef GQMPS2_USE_MPI
+#include <mpi.h>
+#endif
+
 #include "third_party/nlohmann/json.hpp"
 
 
@@ -37,7 +44,36 @@ const char kTwoSiteAlgoWorkflowInitial = 'i';
 const char kTwoSiteAlgoWorkflowRestart = 'r';
 const char kTwoSiteAlgoWorkflowContinue = 'c';
 
+const char kTdvpOneSite = '1';
+const char kTdvpTwoSite = '2';
+
+const char kMpsCompressSvd = 's';
+const char kMpsCompressOneSite = '1';
+const char kMpsCompressTwoSite = '2';
+const long kMpsZipUpDmaxFactor = 2;
+
 const int kLanczEnergyOutputPrecision = 16;
+const double kLanczosExpMinSubstep = 1.0E-10;
+const long kLanczosMaxRefineRestarts = 10;
+const double kBlockLanczosLinDepTol = 1.0E-8;
+const double kRealTenImagTol = 1.0E-12;
+// DensMatSvd solves the reduced density matrix, whose eigenvalues are the
+// squared singular values. Its rounding error is about 1e-16 of the largest
+// eigenvalue, so the singular values below about 1e-8 of the largest one are
+// lost, and the relative error of a kept eigenvalue near kDensMatSvdEigTol is
+// about 1e-4. Below it, DensMatSvd falls back to BlockSvd.
+const double kDensMatSvdEigTol = 1.0E-12;
+const double kParallelInvSvalEps = 1.0E-12;
+const std::size_t kDistMsgMaxElemNum = 1 << 27;
+
+const char kEntSpecFormatJson = 'j';
+const char kEntSpecFormatMsgPack = 'm';
+
+const char kMeasuResFileFormatJson = 'j';
+const char kMeasuResFileFormatBinary = 'b';
+const std::string kMeasuResBinFileSuffix = "gqmr";
+const char kMeasuResBinFileMagic[] = "GQMR";
+const std::uint32_t kMeasuResBinFileVersion = 1;
 
 template <typename TenElemType>
 const GQTensor<TenElemType> kNullOperator = GQTensor<TenElemType>();    // C++14
@@ -195,11 +231,18 @@ struct LanczosParams {
       error(err), max_iterations(max_iter) {}
   LanczosParams(double err) : LanczosParams(err, 200) {}
   LanczosParams(void) : LanczosParams(1.0E-7, 200) {}
-  LanczosParams(const LanczosParams &lancz_params) :
-      LanczosParams(lancz_params.error, lancz_params.max_iterations) {}
 
   double error;
   long max_iterations;
+  // Store the Krylov vectors, except the ones used by the recurrence, in
+  // single precision to save memory. The effective Hamiltonian is applied in
+  // double precision. The ground state is refined in double precision at the
+  // end until its residual norm is below sqrt(error).
+  bool single_prec_bases = false;
+  // Apply the two-site effective Hamiltonian by the ranks of the
+  // distributed-memory mode, with the blocks and the MPO tensors of the
+  // effective Hamiltonian being the slices of the rank.
+  bool distributed = false;
 };
 
 template <typename TenElemType>
@@ -209,10 +252,50 @@ struct LanczosRes {
   GQTensor<TenElemType> *gs_vec;
 };
 
+// The penalty penalty_weight * sum_k |penalty_state_k><penalty_state_k| is
+// added to the effective Hamiltonian if penalty states are given.
 template <typename TenElemType>
 LanczosRes<TenElemType> LanczosSolver(
     const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *,
     const LanczosParams &,
+    const std::string &,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states = {},
+    const double penalty_weight = 0.0);
+
+// Block Lanczos solver for the lowest states, one for each init state. States
+// of a degenerate level are all found if there are enough init states.
+template <typename TenElemType>
+struct BlockLanczosRes {
+  long iters;
+  std::vector<double> engs;
+  std::vector<GQTensor<TenElemType> *> vecs;
+};
+
+template <typename TenElemType>
+BlockLanczosRes<TenElemType> BlockLanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &,
+    const std::vector<GQTensor<TenElemType> *> &,
+    const LanczosParams &,
+    const std::string &,
+    const std::vector<GQTensor<TenElemType> *> &penalty_states = {},
+    const double penalty_weight = 0.0);
+
+// Krylov space matrix exponential, exp(coef * H_eff) |init_state>. The
+// params.error bounds the estimated error of every substep and
+// params.max_iterations bounds the Krylov space dimension.
+template <typename TenElemType>
+struct LanczosExpRes {
+  long iters;       // Number of effective Hamiltonian multiplications.
+  long substeps;
+  double err;       // Sum of the estimated errors of the substeps.
+  GQTensor<TenElemType> *res_vec;
+};
+
+template <typename TenElemType>
+LanczosExpRes<TenElemType> LanczosExpSolver(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *,
+    const TenElemType,
+    const LanczosParams &,
     const std::string &);
 
 
@@ -238,13 +321,240 @@ struct SweepParams {
   char Workflow;
 
   LanczosParams LanczParams;
+
+  // Weight of the density matrix perturbation of the truncation. With it, the
+  // truncation error is still of the unperturbed state, but the entanglement
+  // is of the kept singular values of the perturbed one.
+  double Noise = 0.0;
+
+  // Truncate from the largest eigenpairs of the reduced density matrix on the
+  // kept side instead of the full SVD of the two-site state. The full SVD is
+  // still used when the kept singular values are too small to be resolved.
+  bool DensMatTrunc = false;
+
+  // Threads of the SVD of the two-site state, over its quantum number blocks.
+  unsigned SvdThreadNum = 1;
+
+  // Per sweep schedules of Dmax, Cutoff, the Lanczos error and Noise. The last
+  // value holds for the later sweeps and an empty schedule keeps the value
+  // above.
+  std::vector<long> DmaxSchedule;
+  std::vector<double> CutoffSchedule;
+  std::vector<double> LanczErrSchedule;
+  std::vector<double> NoiseSchedule;
+
+  // Sweeps is the maximal number of sweeps if EnergyConvTol is positive. The
+  // sweeps stop when the energy changes less than EnergyConvTol over a sweep
+  // and the largest truncation error of the sweep is below TruncErrConvTol.
+  double EnergyConvTol = 0.0;
+  double TruncErrConvTol = 1.0;
+
+  // Adaptive Lanczos error if LanczErrRatio is positive. The Lanczos error of
+  // an update is LanczErrRatio times the larger of the truncation error of the
+  // previous update and the energy change over the previous sweep, bounded by
+  // LanczErrFloor and LanczErrCeil. It can not be used with LanczErrSchedule.
+  double LanczErrRatio = 0.0;
+  double LanczErrFloor = 1.0E-14;
+  double LanczErrCeil = 1.0E-4;
+
+  // Distributed-memory mode of TwoSiteAlgorithm. Every rank holds the slices
+  // of the blocks on its quantum number sectors of the MPO bonds and the
+  // effective Hamiltonian is applied as a sum over the ranks. The
+  // intermediates with an MPO bond open are reduced to the owners of its
+  // sectors one owner after another, so with P ranks and a block of dimension
+  // D x w x D a rank holds about 1/P of a block and of an intermediate of
+  // D^2 d^2 w at a time. The MPS, the Lanczos bases of D^2 d^2 each and the
+  // noise perturbation are replicated, so the MPS has to be the same on all
+  // ranks.
+  bool Distributed = false;
+};
+
+// The parameters of the given sweep, with the schedules applied.
+inline SweepParams SweepParamsAt(const SweepParams &, const long sweep);
+
+// Entanglement spectrum of a bond. The Schmidt values are grouped by the
+// quantum number sectors of the bond.
+struct BondEntSpec {
+  std::vector<QN> qns;
+  std::vector<std::vector<double>> svals;
 };
 
+// The i-th element is the spectrum of the bond between site i and site i+1.
+using EntSpec = std::vector<BondEntSpec>;
+
+// If ent_spec is given, the spectra of all the bonds are captured from the
+// last sweep. A complex MPO whose elements are real is swept in real if the
+// sites of the state, of the targets and of the projected states are real up
+// to their phases; the resulting state is real.
 template <typename TenType>
 double TwoSiteAlgorithm(
     std::vector<TenType *> &,
     const std::vector<TenType *> &,
-    const SweepParams &);
+    const SweepParams &,
+    EntSpec *ent_spec = nullptr);
+
+// Excited state search. The penalty
+// penalty_weight * sum_k |proj_mps_k><proj_mps_k| is added to the Hamiltonian,
+// so the lowest state orthogonal to the given normalized converged states is
+// found if the weight is larger than the gap to them. The energy is the
+// expectation of the penalized Hamiltonian. The overlap environments of the
+// given states are kept in memory.
+template <typename TenType>
+double TwoSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    const std::vector<std::vector<TenType *>> &proj_mpss,
+    const double penalty_weight,
+    EntSpec *ent_spec = nullptr);
+
+// State-averaged two-site algorithm for the target_num lowest states. The
+// bonds are truncated by the averaged reduced density matrix of the states,
+// which share the MPS except for the tensor at site 0. mps[0] is the one of
+// the lowest state and the others are held by tgt_head_tens, which are
+// randomly initialized unless target_num-1 of them are given. Returns the
+// energies of the states.
+template <typename TenType>
+std::vector<double> TwoSiteMultiTargetAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    const long target_num,
+    std::vector<TenType *> &tgt_head_tens);
+
+// Distributed-memory mode. With GQMPS2_USE_MPI, the ranks of DistComm(),
+// MPI_COMM_WORLD by default, share the blocks of TwoSiteAlgorithm run with
+// SweepParams::Distributed; otherwise, or before MPI is initialized, there is
+// a single rank. With several ranks, the block files of FileIO carry the rank.
+#ifdef GQMPS2_USE_MPI
+inline MPI_Comm &DistComm(void);
+#endif
+
+inline int DistRank(void);
+
+inline int DistSize(void);
+
+// Infinite DMRG warm-up. The chain is grown from its ends to the center, two
+// sites per step: the step k solves the sites k and N-1-k between the blocks
+// of the k sites at each end, with the MPO bond between the two sites
+// assumed translation invariant. The quantum numbers of the grown chains are
+// those of the product state stat_labs on their sites. The resulting MPS is
+// centered at site 0. With FileIO, the right blocks are dumped like those of
+// the initial workflow, so the sweeps can go on by
+// kTwoSiteAlgoWorkflowContinue. N has to be even. Returns the energy of the
+// last step.
+template <typename TenType>
+double InfiniteWarmUp(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    const std::vector<long> &stat_labs,
+    const Index &pb_out);
+
+// Real-space parallel DMRG, Stoudenmire and White, PRB 87, 155137 (2013). The
+// chain is split into seg_num segments of about equal length, at least 2
+// sites each, which are swept concurrently on their own threads. Neighbouring
+// segments meet at their boundary, whose two sites are solved with the
+// inverse singular values of the bond in between. The MPS has to be right
+// canonical and centered at site 0, like for the initial workflow, and is
+// left so after the sweeps; the blocks are held in memory. The updates run
+// with one BLAS thread and no SvdThreadNum threads each, and are printed in
+// the order of the segments after each half sweep. Returns the mean energy of
+// the boundary updates of the last sweep.
+template <typename TenType>
+double ParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    const long seg_num);
+
+inline BondEntSpec GenBondEntSpec(const GQTensor<GQTEN_Double> &);
+
+// Renyi entropy of order alpha. alpha = 1 gives the von Neumann entropy.
+inline double RenyiEntropy(const BondEntSpec &, const double alpha = 1.0);
+
+inline void DumpEntSpec(
+    const EntSpec &, const std::string &,
+    const char format = kEntSpecFormatJson);
+
+
+// Time dependent variational principle (TDVP) algorithm.
+struct TdvpParams {
+  TdvpParams(
+      const double tau, const long steps,
+      const bool real_time, const char scheme,
+      const long dmin, const long dmax, const double cutoff,
+      const LanczosParams &lancz_params) :
+      Tau(tau), Steps(steps), RealTime(real_time), Scheme(scheme),
+      Dmin(dmin), Dmax(dmax), Cutoff(cutoff),
+      LanczParams(lancz_params) {}
+
+  double Tau;         // Time step.
+  long Steps;
+
+  bool RealTime;      // exp(-iH tau) if true, exp(-H tau) otherwise.
+  char Scheme;        // kTdvpOneSite or kTdvpTwoSite.
+
+  // Truncation of the two-site scheme.
+  long Dmin;
+  long Dmax;
+  double Cutoff;
+
+  LanczosParams LanczParams;
+};
+
+template <typename TenElemType>
+double TdvpAlgorithm(
+    std::vector<GQTensor<TenElemType> *> &,
+    const std::vector<GQTensor<TenElemType> *> &,
+    const TdvpParams &);
+
+
+// Infinite DMRG algorithm for translation invariant chains.
+struct IdmrgParams {
+  IdmrgParams(
+      const long iters, const long cell_sweeps,
+      const long dmin, const long dmax, const double cutoff,
+      const LanczosParams &lancz_params,
+      const double energy_conv_tol) :
+      Iters(iters), CellSweeps(cell_sweeps),
+      Dmin(dmin), Dmax(dmax), Cutoff(cutoff),
+      LanczParams(lancz_params),
+      EnergyConvTol(energy_conv_tol) {}
+
+  long Iters;           // Maximal number of the inserted unit cells.
+  long CellSweeps;      // Two-site sweeps over each inserted unit cell.
+
+  long Dmin;
+  long Dmax;
+  double Cutoff;
+
+  LanczosParams LanczParams;
+
+  double EnergyConvTol; // Of the energy per site.
+  unsigned SvdThreadNum = 1;
+};
+
+// The unit cell of L sites, L even, is given by the product state stat_labs,
+// which sets its quantum numbers. mpo is the MPO of a finite chain of a
+// multiple of L sites, at least 3L, with the translation invariant terms. Its
+// first and last L sites make the chain of 2L sites solved by InfiniteWarmUp
+// to start with. Every iteration inserts a unit cell, with the MPO of mpo[L]
+// to mpo[2L-1], at the center of the chain and solves it by CellSweeps
+// sweeps between the blocks. Its halves then join the blocks, so the cost of
+// an iteration does not depend on the chain length. The first cell is random,
+// the next ones are predicted from the last one by McCulloch's translation of
+// its halves, arXiv:0804.2509. Returns the energy per
+// site from the energy gained by the last two inserted cells, which make up
+// a whole unit cell on each side. The last cell, centered at its first site,
+// is left in cell.
+template <typename TenType>
+double IdmrgAlgorithm(
+    const std::vector<TenType *> &,
+    const std::vector<long> &stat_labs,
+    const Index &pb_out,
+    const IdmrgParams &,
+    std::vector<TenType *> &cell);
 
 
 // MPS operations.
@@ -272,6 +582,54 @@ void ExtendDirectRandomInitMps(
     std::vector<TenType *> &, const std::vector<std::vector<long>> &,
     const Index &, const QN &, const long);
 
+// Pad each bond of the MPS up to dmax states by the quantum number sectors
+// consistent with both ends, then right normalize it. The padded states stay
+// empty for noise = 0 and the state is kept; otherwise a random tensor of norm
+// noise is added on each site.
+template <typename TenType>
+void EnlargeMps(
+    std::vector<TenType *> &, const long,
+    const double noise = 0.0, const unsigned thread_num = 1);
+
+// MPS compression. The bonds are truncated by Dmin, Dmax and Cutoff like the
+// two-site algorithm.
+struct MpsCompressParams {
+  MpsCompressParams(
+      const long dmin, const long dmax, const double cutoff,
+      const char method, const long sweeps) :
+      Dmin(dmin), Dmax(dmax), Cutoff(cutoff),
+      Method(method), Sweeps(sweeps) {}
+
+  long Dmin;
+  long Dmax;
+  double Cutoff;
+
+  // kMpsCompressSvd truncates the canonical MPS by a single SVD sweep.
+  // kMpsCompressOneSite and kMpsCompressTwoSite start from it and fit the MPS
+  // variationally by Sweeps one-site or two-site sweeps with the overlap
+  // environments. The one-site fitting keeps the bond dimensions.
+  char Method;
+  long Sweeps;
+};
+
+// The compressed MPS is normalized and right canonical. Its tensors are
+// allocated here. Returns the fidelity |<compressed_mps|mps>| / ||mps||.
+template <typename TenType>
+double CompressMps(
+    const std::vector<TenType *> &mps,
+    std::vector<TenType *> &compressed_mps,
+    const MpsCompressParams &);
+
+// Compression of mpo applied to mps, which is fitted with the environments of
+// <compressed_mps|mpo|mps> and never formed. Returns the fidelity
+// |<compressed_mps|mpo|mps>| / ||mpo|mps>||.
+template <typename TenType>
+double CompressMps(
+    const std::vector<TenType *> &mpo,
+    const std::vector<TenType *> &mps,
+    std::vector<TenType *> &compressed_mps,
+    const MpsCompressParams &);
+
 
 // Observation measurements.
 template <typename TenType>
@@ -289,6 +647,10 @@ struct MeasuResElem {
   MeasuResElem(void) = default;
   MeasuResElem(const std::vector<long> &sites, const AvgType avg) :
     sites(sites), avg(avg) {}
+  // Promotion of the results measured in real.
+  template <typename OtherAvgType>
+  MeasuResElem(const MeasuResElem<OtherAvgType> &other) :
+    sites(other.sites), avg(other.avg) {}
 
   std::vector<long> sites;
   AvgType avg;
@@ -300,18 +662,52 @@ using MeasuRes = std::vector<MeasuResElem<AvgType>>;
 template <typename AvgType>
 using MeasuResSet = std::vector<MeasuRes<AvgType>>;
 
+// Measurement result writer. The binary file starts with a small header: the
+// magic "GQMR", the format version and the number of doubles of an average.
+// Then one record follows for each event: the event index, the number of
+// sites, the sites and the average. The records are appended as soon as the
+// events are measured, so their order can differ from the order of the
+// events. The JSON file is written at once when the writer is closed.
+template <typename AvgType>
+class MeasuResWriter {
+public:
+  MeasuResWriter(const std::string &, const char);
+  ~MeasuResWriter(void);
+
+  MeasuResWriter(const MeasuResWriter &) = delete;
+  MeasuResWriter &operator=(const MeasuResWriter &) = delete;
+
+  void Write(const std::size_t, const MeasuResElem<AvgType> &);
+  void Close(const MeasuRes<AvgType> &);
+
+private:
+  std::string basename_;
+  char format_;
+  std::ofstream ofs_;
+  std::mutex mtx_;
+};
+
+template <typename AvgType>
+MeasuRes<AvgType> LoadMeasuRes(const std::string &);
+
+
+// The complex measurements are done in real if the operators are real and the
+// sites of the MPS are real up to phases. The MPS is then left as it is.
 
 // Single site operator.
 template <typename TenElemType>
 MeasuRes<TenElemType> MeasureOneSiteOp(
     MPS<GQTensor<TenElemType>> &,
-    const GQTensor<TenElemType> &, const std::string &);
+    const GQTensor<TenElemType> &, const std::string &,
+    const char res_file_format = kMeasuResFileFormatJson);
 
 template <typename TenElemType>
 MeasuResSet<TenElemType> MeasureOneSiteOp(
     MPS<GQTensor<TenElemType>> &,
     const std::vector<GQTensor<TenElemType>> &,
-    const std::vector<std::string> &);
+    const std::vector<std::string> &,
+    const unsigned thread_num = 1,
+    const char res_file_format = kMeasuResFileFormatJson);
 
 template <typename TenElemType>
 MeasuRes<TenElemType> MeasureTwoSiteOp(
@@ -320,7 +716,8 @@ MeasuRes<TenElemType> MeasureTwoSiteOp(
     const GQTensor<TenElemType> &,
     const GQTensor<TenElemType> &,
     const std::vector<std::vector<long>> &,
-    const std::string &);
+    const std::string &,
+    const char res_file_format = kMeasuResFileFormatJson);
 
 template <typename TenElemType>
 MeasuRes<TenElemType> MeasureMultiSiteOp(
@@ -329,7 +726,68 @@ MeasuRes<TenElemType> MeasureMultiSiteOp(
     const std::vector<std::vector<GQTensor<TenElemType>>> &,
     const GQTensor<TenElemType> &,
     const std::vector<std::vector<long>> &,
-    const std::string &);
+    const std::string &,
+    const unsigned thread_num = 1,
+    const char res_file_format = kMeasuResFileFormatJson);
+
+// Measurement session. The canonical forms of a copy of the MPS are prepared
+// once, all the measurements of the session only do tensor contractions and
+// the MPS of the caller is never changed.
+template <typename TenElemType>
+class MeasuSession {
+public:
+  MeasuSession(const std::vector<GQTensor<TenElemType> *> &);
+  ~MeasuSession(void);
+
+  MeasuSession(const MeasuSession &) = delete;
+  MeasuSession &operator=(const MeasuSession &) = delete;
+
+  MeasuRes<TenElemType> MeasureOneSiteOp(
+      const GQTensor<TenElemType> &, const std::string &,
+      const unsigned thread_num = 1,
+      const char res_file_format = kMeasuResFileFormatJson);
+
+  MeasuResSet<TenElemType> MeasureOneSiteOp(
+      const std::vector<GQTensor<TenElemType>> &,
+      const std::vector<std::string> &,
+      const unsigned thread_num = 1,
+      const char res_file_format = kMeasuResFileFormatJson);
+
+  MeasuRes<TenElemType> MeasureTwoSiteOp(
+      const std::vector<GQTensor<TenElemType>> &,
+      const GQTensor<TenElemType> &,
+      const GQTensor<TenElemType> &,
+      const std::vector<std::vector<long>> &,
+      const std::string &,
+      const unsigned thread_num = 1,
+      const char res_file_format = kMeasuResFileFormatJson);
+
+  MeasuRes<TenElemType> MeasureMultiSiteOp(
+      const std::vector<std::vector<GQTensor<TenElemType>>> &,
+      const std::vector<std::vector<GQTensor<TenElemType>>> &,
+      const GQTensor<TenElemType> &,
+      const std::vector<std::vector<long>> &,
+      const std::string &,
+      const unsigned thread_num = 1,
+      const char res_file_format = kMeasuResFileFormatJson);
+
+  // Singular values on the bond between site i and site i+1.
+  const GQTensor<GQTEN_Double> &BondSingularValues(const long i) const {
+    return *svals_[i];
+  }
+
+  const std::size_t N;
+
+private:
+  // Right canonical tensors. The tensor at site 0 is the center tensor.
+  std::vector<GQTensor<TenElemType> *> rtens_;
+  // Center tensor at each site, with left canonical tensors on its left and
+  // right canonical tensors on its right.
+  std::vector<GQTensor<TenElemType> *> cent_tens_;
+  std::vector<GQTensor<GQTEN_Double> *> svals_;
+
+  std::vector<GQTensor<TenElemType> *> CentView(const long) const;
+};
 
 
 // System I/O functions.
@@ -360,7 +818,8 @@ inline void CreatPath(const std::string &path) {
   const int dir_err = mkdir(
                           path.c_str(),
                           S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-  if (dir_err == -1) {
+  // The ranks of the distributed mode may create it at the same time.
+  if (dir_err == -1 && errno != EEXIST) {
     std::cout << "error creating directory!" << std::endl;
     exit(1);
   }
@@ -372,7 +831,10 @@ inline void CreatPath(const std::string &path) {
 #include "gqmps2/detail/lanczos_impl.h"
 #include "gqmps2/detail/mpogen_impl.h"
 #include "gqmps2/detail/two_site_algo_impl.h"
+#include "gqmps2/detail/distributed_impl.h"
 #include "gqmps2/detail/mps_ops_impl.h"
+#include "gqmps2/detail/tdvp_impl.h"
+#include "gqmps2/detail/idmrg_impl.h"
 #include "gqmps2/detail/mps_measu_impl.h"
 
 
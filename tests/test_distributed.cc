@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 16:18
+* 
+* Description: GraceQ/mps2 project. Unittest for the distributed-memory mode,
+* run by mpirun with GQMPS2_USE_MPI.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gtest/gtest.h"
+#include "gqten/gqten.h"
+
+#include <vector>
+#include <complex>
+#include <cstdlib>
+
+
+using namespace gqmps2;
+using namespace gqten;
+using DTenPtrVec = std::vector<DGQTensor *>;
+using ZTenPtrVec = std::vector<ZGQTensor *>;
+
+
+struct TestDistributedSpinSystem : public testing::Test {
+  long N = 10;
+  double benmrk_e0 = -4.258035207282883;
+
+  QN qn0 = QN({QNNameVal("Sz", 0)});
+  Index pb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", 1)}), 1),
+                     QNSector(QN({QNNameVal("Sz", -1)}), 1)}, OUT);
+  Index pb_in = InverseIndex(pb_out);
+
+  DGQTensor  dsz  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsp  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsm  = DGQTensor({pb_in, pb_out});
+  DTenPtrVec dmps = DTenPtrVec(N);
+
+  ZGQTensor  zsz  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsp  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsm  = ZGQTensor({pb_in, pb_out});
+  ZTenPtrVec zmps = ZTenPtrVec(N);
+
+  void SetUp(void) {
+    dsz({0, 0}) = 0.5;
+    dsz({1, 1}) = -0.5;
+    dsp({0, 1}) = 1;
+    dsm({1, 0}) = 1;
+
+    zsz({0, 0}) = 0.5;
+    zsz({1, 1}) = -0.5;
+    zsp({0, 1}) = 1;
+    zsm({1, 0}) = 1;
+  }
+};
+
+
+// The MPS is initialized by the same seed on all the ranks.
+TEST_F(TestDistributedSpinSystem, 1DHeisenberg) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                          4,
+                          32, 32, 1.0E-12,
+                          false,
+                          kTwoSiteAlgoWorkflowInitial,
+                          LanczosParams(1.0E-10));
+  sweep_params.Distributed = true;
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  auto e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  EXPECT_NEAR(e0, benmrk_e0, 1.0E-10);
+
+  // The sliced blocks go through the files of the ranks and the noise
+  // perturbation is summed over the ranks.
+  sweep_params.FileIO = true;
+  sweep_params.Sweeps = 2;
+  sweep_params.NoiseSchedule = {1.0E-4, 0.0};
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowContinue;
+  sweep_params.NoiseSchedule = {};
+  e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  EXPECT_NEAR(e0, benmrk_e0, 1.0E-10);
+
+  // The exchange with a phase is complex and gauge equivalent to the real one.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1, {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, 0.3), {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, -0.3), {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  sweep_params.FileIO = false;
+  sweep_params.Sweeps = 4;
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowInitial;
+  srand(0);
+  RandomInitMps(zmps, pb_out, qn0, qn0, 4);
+  e0 = TwoSiteAlgorithm(zmps, zmpo, sweep_params);
+  EXPECT_NEAR(e0, benmrk_e0, 1.0E-10);
+}
+
+
+// A tensor with the same elements on all the ranks sums to DistSize times it.
+TEST_F(TestDistributedSpinSystem, ReduceSum) {
+  auto mpo_bond = Index({
+                      QNSector(QN({QNNameVal("Sz", 0)}), 3),
+                      QNSector(QN({QNNameVal("Sz", 2)}), 1),
+                      QNSector(QN({QNNameVal("Sz", -2)}), 1)}, OUT);
+  auto t = DGQTensor({pb_in, mpo_bond, pb_out});
+  srand(0);
+  t.Random(qn0);
+  auto scaled_t = DGQTensor(t.indexes);
+  LinearCombine({double(DistSize())}, {&t}, &scaled_t);
+
+  auto sum = new DGQTensor(t);
+  DistAllReduceSum(sum, qn0);
+  auto diff = DGQTensor(scaled_t);
+  LinearCombine({-1.0}, {sum}, &diff);
+  EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-12);
+  delete sum;
+
+  // Only the sectors of the rank are summed to it.
+  auto slice = DistReduceSlice(t, 1, qn0);
+  auto scaled_slice = GenDistSlice(scaled_t, 1);
+  EXPECT_EQ(slice->indexes[1], scaled_slice->indexes[1]);
+  auto slice_diff = DGQTensor(*scaled_slice);
+  LinearCombine({-1.0}, {slice}, &slice_diff);
+  EXPECT_NEAR(slice_diff.Normalize(), 0.0, 1.0E-12);
+  delete slice;
+  delete scaled_slice;
+}
+
+
+int main(int argc, char *argv[]) {
+#ifdef GQMPS2_USE_MPI
+  MPI_Init(&argc, &argv);
+#endif
+  testing::InitGoogleTest(&argc, argv);
+  auto res = RUN_ALL_TESTS();
+#ifdef GQMPS2_USE_MPI
+  MPI_Finalize();
+#endif
+  return res;
+}
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 15:45
+* 
+* Description: GraceQ/mps2 project. Unittest for infinite DMRG algorithm.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gtest/gtest.h"
+#include "gqten/gqten.h"
+
+#include <vector>
+#include <cmath>
+
+
+using namespace gqmps2;
+using namespace gqten;
+using DTenPtrVec = std::vector<DGQTensor *>;
+
+
+struct TestIdmrgSpinSystem : public testing::Test {
+  QN qn0 = QN({QNNameVal("Sz", 0)});
+  Index pb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", 1)}), 1),
+                     QNSector(QN({QNNameVal("Sz", -1)}), 1)}, OUT);
+  Index pb_in = InverseIndex(pb_out);
+
+  DGQTensor  dsz  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsp  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsm  = DGQTensor({pb_in, pb_out});
+
+  void SetUp(void) {
+    dsz({0, 0}) = 0.5;
+    dsz({1, 1}) = -0.5;
+    dsp({0, 1}) = 1;
+    dsm({1, 0}) = 1;
+  }
+};
+
+
+TEST_F(TestIdmrgSpinSystem, 1DHeisenberg) {
+  auto e0_exact = 0.25 - std::log(2.0);
+  auto idmrg_params = IdmrgParams(
+                          200, 1,
+                          1, 16, 1.0E-10,
+                          LanczosParams(1.0E-9),
+                          1.0E-8);
+
+  // Two-site unit cell.
+  long L = 2;
+  long N = 3*L;
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+  DTenPtrVec dcell;
+  auto e0 = IdmrgAlgorithm(dmpo, {0, 1}, pb_out, idmrg_params, dcell);
+  EXPECT_NEAR(e0, e0_exact, 1.0E-4);
+  EXPECT_EQ(dcell.size(), L);
+
+  // Four-site unit cell with two sweeps over each cell.
+  L = 4;
+  N = 3*L;
+  dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  dmpo = dmpo_gen.Gen();
+  idmrg_params.CellSweeps = 2;
+  e0 = IdmrgAlgorithm(dmpo, {0, 1, 0, 1}, pb_out, idmrg_params, dcell);
+  EXPECT_NEAR(e0, e0_exact, 1.0E-4);
+  EXPECT_EQ(dcell.size(), L);
+  for (auto &cell_ten : dcell) { delete cell_ten; }
+}
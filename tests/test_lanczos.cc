@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <iostream>
+#include <cmath>
 
 #include <assert.h>
 
@@ -65,6 +66,23 @@ void RunTestCentLanczosSolverCase(
   assert(eff_ham_ten->cblocks().size() == 1);
   auto dense_mat = eff_ham_ten->blocks()[0]->data();
   auto dense_mat_dim = D * d * d * D;
+
+  // The ground state from the single precision bases is refined until its
+  // residual is small.
+  if (lanczos_params.single_prec_bases) {
+    assert(lancz_res.gs_vec->cblocks().size() == 1);
+    auto gs_vec = lancz_res.gs_vec->cblocks()[0]->cdata();
+    double res_norm2 = 0.0;
+    for (long i = 0; i < dense_mat_dim; ++i) {
+      TenElemType res_elem = - lancz_res.gs_eng * gs_vec[i];
+      for (long j = 0; j < dense_mat_dim; ++j) {
+        res_elem += dense_mat[j*dense_mat_dim + i] * gs_vec[j];
+      }
+      res_norm2 += std::norm(res_elem);
+    }
+    EXPECT_LT(std::sqrt(res_norm2), std::sqrt(lanczos_params.error));
+  }
+
   for (long i = 0; i < dense_mat_dim; ++i) {
     for (long j = 0; j < dense_mat_dim; ++j) {
       if (i > j) {
@@ -133,6 +151,17 @@ TEST_F(TestLanczos, TestCentLanczosSolver) {
       pdinit_state,
       lanczos_params2);
 
+  // Single precision bases.
+  pdinit_state = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  LanczosParams single_prec_lanczos_params(1.0E-9);
+  single_prec_lanczos_params.single_prec_bases = true;
+  RunTestCentLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      pdinit_state,
+      single_prec_lanczos_params);
+
   // Tensor with complex elements.
   auto zlblock = ZGQTensor({idx_Dout, idx_dh, idx_Din});
   auto zlsite  = ZGQTensor({idx_dh, idx_din, idx_dout, idx_dh});
@@ -168,6 +197,15 @@ TEST_F(TestLanczos, TestCentLanczosSolver) {
       {&zlblock, &zlsite, &zrsite, &zrblock},
       pzinit_state,
       lanczos_params);
+
+  // Single precision bases.
+  pzinit_state = new ZGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pzinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  RunTestCentLanczosSolverCase(
+      {&zlblock, &zlsite, &zrsite, &zrblock},
+      pzinit_state,
+      single_prec_lanczos_params);
 }
 
 
@@ -284,3 +322,95 @@ TEST_F(TestLanczos, TestLendLanczosSolver) {
       pzinit_state,
       lanczos_params);
 }
+
+
+TEST_F(TestLanczos, TestLendLanczosExpSolver) {
+  auto dlsite = DGQTensor({idx_din, idx_dh, idx_dout});
+  auto drsite = DGQTensor({idx_dh, idx_din, idx_dout, idx_dh});
+  auto drblock = DGQTensor({idx_Din, idx_dh, idx_Dout});
+  auto dblock_random_mat = new double [D*D];
+  RandRealSymMat(dblock_random_mat, D);
+  for (long i = 0; i < D; ++i) {
+    for (long j = 0; j < D; ++j) {
+      for (long k = 0; k < dh; ++k) {
+        drblock({j, k, i}) = dblock_random_mat[(i*D+j)];
+      }
+    }
+  }
+  delete[] dblock_random_mat;
+  auto dsite_random_mat = new double [d*d];
+  RandRealSymMat(dsite_random_mat, d);
+  for (long i = 0; i < d; ++i) {
+    for (long j = 0; j < d; ++j) {
+      for (long k = 0; k < dh; ++k) {
+        dlsite({i, k, j}) = dsite_random_mat[(i*d+j)];
+        drsite({k, i, j, k}) = dsite_random_mat[(i*d+j)];
+      }
+    }
+  }
+  delete[] dsite_random_mat;
+  auto dnull_ten = DGQTensor();
+  std::vector<DGQTensor *> eff_ham = {&dnull_ten, &dlsite, &drsite, &drblock};
+  auto init_state = DGQTensor({idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  init_state.Random(QN({QNNameVal("Sz", 0)}));
+
+  // Dense exp(tau * H) |init_state>.
+  double tau = -0.1;
+  auto eff_ham_ten = Contract(*eff_ham[1], *eff_ham[2], {{1}, {0}});
+  InplaceContract(eff_ham_ten, *eff_ham[3], {{4}, {1}});
+  eff_ham_ten->Transpose({0, 2, 4, 1, 3, 5});
+  assert(eff_ham_ten->cblocks().size() == 1);
+  auto dense_mat = eff_ham_ten->blocks()[0]->data();
+  auto dense_mat_dim = d * d * D;
+  auto w = new double [dense_mat_dim];
+  LapackeSyev(
+      LAPACK_ROW_MAJOR, 'V', 'U',
+      dense_mat_dim, dense_mat, dense_mat_dim, w);
+  std::vector<double> init_vec(dense_mat_dim), exact_vec(dense_mat_dim, 0.0);
+  for (long i = 0; i < d; ++i) {
+    for (long j = 0; j < d; ++j) {
+      for (long k = 0; k < D; ++k) {
+        init_vec[(i*d + j)*D + k] = init_state.Elem({i, j, k});
+      }
+    }
+  }
+  for (long n = 0; n < dense_mat_dim; ++n) {
+    double proj = 0.0;
+    for (long m = 0; m < dense_mat_dim; ++m) {
+      proj += dense_mat[m*dense_mat_dim + n] * init_vec[m];
+    }
+    proj *= std::exp(tau * w[n]);
+    for (long m = 0; m < dense_mat_dim; ++m) {
+      exact_vec[m] += proj * dense_mat[m*dense_mat_dim + n];
+    }
+  }
+  double exact_norm = 0.0;
+  for (auto &elem : exact_vec) { exact_norm += elem * elem; }
+  exact_norm = std::sqrt(exact_norm);
+
+  // Finish in a single Krylov space and with substeps when the Krylov space
+  // is limited.
+  for (long max_iter : {100, 6}) {
+    auto pstate = new DGQTensor(init_state);
+    LanczosParams lanczos_params(1.0E-12, max_iter);
+    auto lancz_exp_res = LanczosExpSolver(
+                             eff_ham, pstate, tau,
+                             lanczos_params,
+                             "lend");
+    if (max_iter == 6) { EXPECT_GT(lancz_exp_res.substeps, 1); }
+    for (long i = 0; i < d; ++i) {
+      for (long j = 0; j < d; ++j) {
+        for (long k = 0; k < D; ++k) {
+          EXPECT_NEAR(
+              lancz_exp_res.res_vec->Elem({i, j, k}) / exact_norm,
+              exact_vec[(i*d + j)*D + k] / exact_norm,
+              1.0E-8);
+        }
+      }
+    }
+    delete lancz_exp_res.res_vec;
+  }
+  delete eff_ham_ten;
+  delete[] w;
+}
@@ -112,6 +112,42 @@ TEST_F(TestMpsMeasurement, TestMeasureOneSiteOp) {
   MpsFree(zmps2);
 }
 
+// The operator on the head site is contracted with the physical leg by its
+// incoming leg, as on the other sites. The operator is not symmetric, so the
+// other leg gives the average of its transpose.
+TEST_F(TestMpsMeasurement, TestMeasureOneSiteOpAtChainHead) {
+  Index pb1_out = Index({QNSector(qn0, 2)}, OUT);
+  Index pb1_in = InverseIndex(pb1_out);
+  Index vb_out = Index({QNSector(qn0, 1)}, OUT);
+  Index vb_in = InverseIndex(vb_out);
+  ZGQTensor zsy({pb1_in, pb1_out});
+  zsy({0, 1}) = GQTEN_Complex(0, -1);
+  zsy({1, 0}) = GQTEN_Complex(0, 1);
+
+  // Every site is in (|0> + i|1>) / sqrt(2).
+  auto amp0 = GQTEN_Complex(1, 0) / std::sqrt(2.0);
+  auto amp1 = GQTEN_Complex(0, 1) / std::sqrt(2.0);
+  auto zmps1 = zmps;
+  zmps1[0] = new ZGQTensor({pb1_out, vb_out});
+  (*zmps1[0])({0, 0}) = amp0;
+  (*zmps1[0])({1, 0}) = amp1;
+  for (long i = 1; i < N-1; ++i) {
+    zmps1[i] = new ZGQTensor({vb_in, pb1_out, vb_out});
+    (*zmps1[i])({0, 0, 0}) = amp0;
+    (*zmps1[i])({0, 1, 0}) = amp1;
+  }
+  zmps1[N-1] = new ZGQTensor({vb_in, pb1_out});
+  (*zmps1[N-1])({0, 0}) = amp0;
+  (*zmps1[N-1])({0, 1}) = amp1;
+  auto zmps_for_measu1 = MPS<ZGQTensor>(zmps1, -1);
+  auto measu_res = MeasureOneSiteOp(zmps_for_measu1, zsy, "sy");
+  for (long i = 0; i < N; ++i) {
+    EXPECT_NEAR(measu_res[i].avg.real(), -1.0, 1.0E-14);
+    EXPECT_NEAR(measu_res[i].avg.imag(), 0.0, 1.0E-14);
+  }
+  MpsFree(zmps1);
+}
+
 
 template <typename MpsType, typename TenElemType>
 void RunTestMeasureTwoSiteOpCase(
@@ -179,3 +215,327 @@ TEST_F(TestMpsMeasurement, TestMeasureTwoSiteOp) {
       zmps_for_measu2, {zntot, zntot}, zid, zid, sites_set, zres2);
   MpsFree(zmps2);
 }
+
+
+// The tail operator on the last site is contracted with its physical legs.
+TEST_F(TestMpsMeasurement, TestMeasureTwoSiteOpAtChainEnd) {
+  std::vector<std::vector<long>> sites_set = {{0, 5}, {1, 5}, {3, 5}, {4, 5}};
+
+  auto dmps1 = dmps;
+  DirectStateInitMps(dmps1, stat_labs2, pb_out, qn0);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1);
+  std::vector<GQTEN_Double> dres1 = {1, 1, 1, 1};
+  RunTestMeasureTwoSiteOpCase(
+      dmps_for_measu1, {did, dntot}, did, did, sites_set, dres1);
+  std::vector<GQTEN_Double> dres2 = {0, 1, 1, 0};
+  RunTestMeasureTwoSiteOpCase(
+      dmps_for_measu1, {dntot, did}, did, did, sites_set, dres2);
+  MpsFree(dmps1);
+
+  auto zmps1 = zmps;
+  DirectStateInitMps(zmps1, stat_labs2, pb_out, qn0);
+  auto zmps_for_measu1 = MPS<ZGQTensor>(zmps1, -1);
+  std::vector<GQTEN_Complex> zres1 = {1, 1, 1, 1};
+  RunTestMeasureTwoSiteOpCase(
+      zmps_for_measu1, {zid, zntot}, zid, zid, sites_set, zres1);
+  MpsFree(zmps1);
+}
+
+
+TEST_F(TestMpsMeasurement, TestMeasureTwoSiteOpUnsortedEvents) {
+  std::vector<std::vector<long>> sites_set = {
+                                               {4, 5}, {1, 3}, {0, 2},
+                                               {1, 5}, {0, 5}, {1, 2}
+                                             };
+  std::vector<GQTEN_Double> dres = {0, 1, 0, 1, 0, 0};
+
+  auto dmps1 = dmps;
+  DirectStateInitMps(dmps1, stat_labs2, pb_out, qn0);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1); 
+  auto measu_res = MeasureTwoSiteOp(
+                       dmps_for_measu1,
+                       {dntot, dntot}, did, did,
+                       sites_set,
+                       "op1op2");
+  assert(measu_res.size() == dres.size());
+  for (size_t i = 0; i < dres.size(); ++i) {
+    EXPECT_EQ(measu_res[i].sites, sites_set[i]);
+    ExpectDoubleEq(measu_res[i].avg, dres[i]);
+  }
+  MpsFree(dmps1);
+}
+
+
+TEST_F(TestMpsMeasurement, TestParallelMeasurement) {
+  auto dmps1 = dmps;
+  srand(0);
+  RandomInitMps(dmps1, pb_out, QN({QNNameVal("N", 3)}), qn0, 4);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1); 
+
+  // Multi-site operators.
+  std::vector<std::vector<long>> sites_set = {
+                                               {1, 4}, {0, 2}, {0, 1, 5},
+                                               {2, 3, 4}, {1, 2}, {0, 5}
+                                             };
+  std::vector<std::vector<DGQTensor>> phys_ops_set;
+  std::vector<std::vector<DGQTensor>> inst_ops_set;
+  for (auto &sites : sites_set) {
+    phys_ops_set.push_back(std::vector<DGQTensor>(sites.size(), dntot));
+    inst_ops_set.push_back(std::vector<DGQTensor>(sites.size()-1, did));
+  }
+  auto serial_res = MeasureMultiSiteOp(
+                        dmps_for_measu1,
+                        phys_ops_set, inst_ops_set, did,
+                        sites_set,
+                        "multi_site_op");
+  auto parallel_res = MeasureMultiSiteOp(
+                          dmps_for_measu1,
+                          phys_ops_set, inst_ops_set, did,
+                          sites_set,
+                          "multi_site_op",
+                          4);
+  assert(serial_res.size() == parallel_res.size());
+  for (size_t i = 0; i < serial_res.size(); ++i) {
+    EXPECT_EQ(parallel_res[i].sites, sites_set[i]);
+    EXPECT_NEAR(parallel_res[i].avg, serial_res[i].avg, 1.0E-12);
+  }
+
+  // One-site operators.
+  auto serial_res_set = MeasureOneSiteOp(
+                            dmps_for_measu1,
+                            {dntot, did}, {"ntot", "id"});
+  auto parallel_res_set = MeasureOneSiteOp(
+                              dmps_for_measu1,
+                              {dntot, did}, {"ntot", "id"},
+                              4);
+  for (size_t i = 0; i < serial_res_set.size(); ++i) {
+    for (long j = 0; j < N; ++j) {
+      EXPECT_NEAR(
+          parallel_res_set[i][j].avg, serial_res_set[i][j].avg, 1.0E-12);
+    }
+  }
+  MpsFree(dmps1);
+}
+
+
+TEST_F(TestMpsMeasurement, TestParallelCentralizeMps) {
+  auto dmps1 = dmps;
+  srand(0);
+  RandomInitMps(dmps1, pb_out, QN({QNNameVal("N", 3)}), qn0, 4);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1);
+  auto serial_res_set = MeasureOneSiteOp(
+                            dmps_for_measu1,
+                            {dntot, did}, {"ntot", "id"});
+
+  // Centralized by the decompositions over the quantum number blocks in
+  // parallel.
+  DTenPtrVec dmps2(N);
+  for (long i = 0; i < N; ++i) { dmps2[i] = new DGQTensor(*dmps1[i]); }
+  auto dmps_for_measu2 = MPS<DGQTensor>(dmps2, -1);
+  CentralizeMps(dmps_for_measu2, 2, 4);
+  auto centralized_res_set = MeasureOneSiteOp(
+                                 dmps_for_measu2,
+                                 {dntot, did}, {"ntot", "id"});
+  for (size_t i = 0; i < serial_res_set.size(); ++i) {
+    for (long j = 0; j < N; ++j) {
+      EXPECT_NEAR(
+          centralized_res_set[i][j].avg, serial_res_set[i][j].avg, 1.0E-12);
+    }
+  }
+  MpsFree(dmps1);
+  MpsFree(dmps2);
+}
+
+
+TEST_F(TestMpsMeasurement, TestMeasuSession) {
+  auto dmps1 = dmps;
+  srand(0);
+  RandomInitMps(dmps1, pb_out, QN({QNNameVal("N", 3)}), qn0, 4);
+  std::vector<DGQTensor> orig_tens;
+  for (auto &t : dmps1) { orig_tens.push_back(*t); }
+  MeasuSession<GQTEN_Double> session(dmps1);
+  for (long i = 0; i < N; ++i) { EXPECT_TRUE(*dmps1[i] == orig_tens[i]); }
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1);
+
+  // One-site operators.
+  auto res_set = MeasureOneSiteOp(
+                     dmps_for_measu1,
+                     {dntot, did}, {"ntot", "id"});
+  auto session_res_set = session.MeasureOneSiteOp(
+                             {dntot, did}, {"ntot", "id"}, 2);
+  for (size_t i = 0; i < res_set.size(); ++i) {
+    for (long j = 0; j < N; ++j) {
+      EXPECT_NEAR(session_res_set[i][j].avg, res_set[i][j].avg, 1.0E-12);
+    }
+  }
+
+  // Two-site operators.
+  std::vector<std::vector<long>> sites_set = {{2, 4}, {0, 1}, {0, 5}, {1, 3}};
+  auto res = MeasureTwoSiteOp(
+                 dmps_for_measu1,
+                 {dntot, dntot}, did, did,
+                 sites_set,
+                 "op1op2");
+  auto session_res = session.MeasureTwoSiteOp(
+                         {dntot, dntot}, did, did,
+                         sites_set,
+                         "op1op2",
+                         2);
+  for (size_t i = 0; i < res.size(); ++i) {
+    EXPECT_EQ(session_res[i].sites, sites_set[i]);
+    EXPECT_NEAR(session_res[i].avg, res[i].avg, 1.0E-12);
+  }
+
+  // Multi-site operators.
+  sites_set = {{1, 4}, {0, 2, 3}, {2, 3, 5}};
+  std::vector<std::vector<DGQTensor>> phys_ops_set;
+  std::vector<std::vector<DGQTensor>> inst_ops_set;
+  for (auto &sites : sites_set) {
+    phys_ops_set.push_back(std::vector<DGQTensor>(sites.size(), dntot));
+    inst_ops_set.push_back(std::vector<DGQTensor>(sites.size()-1, did));
+  }
+  res = MeasureMultiSiteOp(
+            dmps_for_measu1,
+            phys_ops_set, inst_ops_set, did,
+            sites_set,
+            "multi_site_op");
+  session_res = session.MeasureMultiSiteOp(
+                    phys_ops_set, inst_ops_set, did,
+                    sites_set,
+                    "multi_site_op");
+  for (size_t i = 0; i < res.size(); ++i) {
+    EXPECT_NEAR(session_res[i].avg, res[i].avg, 1.0E-12);
+  }
+  MpsFree(dmps1);
+}
+
+
+TEST_F(TestMpsMeasurement, TestRealMeasurementOfComplexMps) {
+  auto dmps1 = dmps;
+  srand(0);
+  RandomInitMps(dmps1, pb_out, QN({QNNameVal("N", 3)}), qn0, 4);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1);
+
+  // The sites of the complex MPS are the real ones with phases.
+  auto zmps1 = zmps;
+  for (long i = 0; i < N; ++i) {
+    zmps1[i] = GenPromotedTen<ZGQTensor>(*dmps1[i]);
+    *zmps1[i] *= std::exp(GQTEN_Complex(0, 0.3*(i+1)));
+  }
+  auto zmps_for_measu1 = MPS<ZGQTensor>(zmps1, -1);
+  std::vector<ZGQTensor> zmps1_tens;
+  for (auto &mps_ten : zmps1) { zmps1_tens.push_back(*mps_ten); }
+
+  auto dres_set = MeasureOneSiteOp(
+                      dmps_for_measu1,
+                      {dntot, did}, {"ntot", "id"});
+  auto zres_set = MeasureOneSiteOp(
+                      zmps_for_measu1,
+                      {zntot, zid}, {"ntot", "id"});
+  for (size_t i = 0; i < dres_set.size(); ++i) {
+    for (long j = 0; j < N; ++j) {
+      EXPECT_NEAR(zres_set[i][j].avg.real(), dres_set[i][j].avg, 1.0E-12);
+      EXPECT_NEAR(zres_set[i][j].avg.imag(), 0.0, 1.0E-12);
+    }
+  }
+  // The measurement in real leaves the complex MPS as it is.
+  EXPECT_EQ(zmps_for_measu1.center, -1);
+  for (long i = 0; i < N; ++i) { EXPECT_TRUE(*zmps1[i] == zmps1_tens[i]); }
+
+  std::vector<std::vector<long>> sites_set = {{2, 4}, {0, 1}, {0, 5}, {1, 3}};
+  auto dres = MeasureTwoSiteOp(
+                  dmps_for_measu1,
+                  {dntot, dntot}, did, did,
+                  sites_set,
+                  "op1op2");
+  auto zres = MeasureTwoSiteOp(
+                  zmps_for_measu1,
+                  {zntot, zntot}, zid, zid,
+                  sites_set,
+                  "op1op2");
+  for (size_t i = 0; i < dres.size(); ++i) {
+    EXPECT_EQ(zres[i].sites, sites_set[i]);
+    EXPECT_NEAR(zres[i].avg.real(), dres[i].avg, 1.0E-12);
+    EXPECT_NEAR(zres[i].avg.imag(), 0.0, 1.0E-12);
+  }
+
+  // An operator with an imaginary part is measured in complex.
+  auto zintot = zntot * GQTEN_Complex(0, 1);
+  sites_set = {{1, 4}, {0, 2, 3}};
+  std::vector<std::vector<DGQTensor>> dphys_ops_set;
+  std::vector<std::vector<DGQTensor>> dinst_ops_set;
+  std::vector<std::vector<ZGQTensor>> zphys_ops_set;
+  std::vector<std::vector<ZGQTensor>> zinst_ops_set;
+  for (auto &sites : sites_set) {
+    dphys_ops_set.push_back(std::vector<DGQTensor>(sites.size(), dntot));
+    dinst_ops_set.push_back(std::vector<DGQTensor>(sites.size()-1, did));
+    std::vector<ZGQTensor> zphys_ops(sites.size(), zntot);
+    zphys_ops[0] = zintot;
+    zphys_ops_set.push_back(zphys_ops);
+    zinst_ops_set.push_back(std::vector<ZGQTensor>(sites.size()-1, zid));
+  }
+  dres = MeasureMultiSiteOp(
+             dmps_for_measu1,
+             dphys_ops_set, dinst_ops_set, did,
+             sites_set,
+             "multi_site_op");
+  zres = MeasureMultiSiteOp(
+             zmps_for_measu1,
+             zphys_ops_set, zinst_ops_set, zid,
+             sites_set,
+             "multi_site_op");
+  for (size_t i = 0; i < dres.size(); ++i) {
+    EXPECT_NEAR(zres[i].avg.real(), 0.0, 1.0E-12);
+    EXPECT_NEAR(zres[i].avg.imag(), dres[i].avg, 1.0E-12);
+  }
+  MpsFree(dmps1);
+  MpsFree(zmps1);
+}
+
+
+TEST_F(TestMpsMeasurement, TestBinaryMeasuResFile) {
+  auto dmps1 = dmps;
+  srand(0);
+  RandomInitMps(dmps1, pb_out, QN({QNNameVal("N", 3)}), qn0, 4);
+  auto dmps_for_measu1 = MPS<DGQTensor>(dmps1, -1);
+
+  std::vector<std::vector<long>> sites_set = {
+                                               {1, 4}, {0, 2}, {0, 1, 5},
+                                               {2, 3, 4}, {1, 2}, {0, 5}
+                                             };
+  std::vector<std::vector<DGQTensor>> phys_ops_set;
+  std::vector<std::vector<DGQTensor>> inst_ops_set;
+  for (auto &sites : sites_set) {
+    phys_ops_set.push_back(std::vector<DGQTensor>(sites.size(), dntot));
+    inst_ops_set.push_back(std::vector<DGQTensor>(sites.size()-1, did));
+  }
+  auto measu_res = MeasureMultiSiteOp(
+                       dmps_for_measu1,
+                       phys_ops_set, inst_ops_set, did,
+                       sites_set,
+                       "multi_site_op",
+                       4,
+                       kMeasuResFileFormatBinary);
+  auto loaded_res = LoadMeasuRes<GQTEN_Double>("multi_site_op");
+  assert(loaded_res.size() == measu_res.size());
+  for (size_t i = 0; i < measu_res.size(); ++i) {
+    EXPECT_EQ(loaded_res[i].sites, sites_set[i]);
+    EXPECT_EQ(loaded_res[i].avg, measu_res[i].avg);
+  }
+
+  MeasuSession<GQTEN_Double> session(dmps1);
+  sites_set = {{2, 4}, {0, 1}, {0, 5}, {1, 3}};
+  measu_res = session.MeasureTwoSiteOp(
+                  {dntot, dntot}, did, did,
+                  sites_set,
+                  "op1op2",
+                  2,
+                  kMeasuResFileFormatBinary);
+  loaded_res = LoadMeasuRes<GQTEN_Double>("op1op2");
+  assert(loaded_res.size() == measu_res.size());
+  for (size_t i = 0; i < measu_res.size(); ++i) {
+    EXPECT_EQ(loaded_res[i].sites, sites_set[i]);
+    EXPECT_EQ(loaded_res[i].avg, measu_res[i].avg);
+  }
+  MpsFree(dmps1);
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 13:28
+* 
+* Description: GraceQ/mps2 project. Unittest for TDVP algorithm.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gtest/gtest.h"
+#include "gqten/gqten.h"
+
+#include <vector>
+
+
+using namespace gqmps2;
+using namespace gqten;
+using DTenPtrVec = std::vector<DGQTensor *>;
+using ZTenPtrVec = std::vector<ZGQTensor *>;
+
+
+struct TestTdvpSpinSystem : public testing::Test {
+  long N = 6;
+
+  QN qn0 = QN({QNNameVal("Sz", 0)});
+  Index pb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", 1)}), 1),
+                     QNSector(QN({QNNameVal("Sz", -1)}), 1)}, OUT);
+  Index pb_in = InverseIndex(pb_out);
+
+  DGQTensor  dsz  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsp  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsm  = DGQTensor({pb_in, pb_out});
+  DTenPtrVec dmps = DTenPtrVec(N);
+
+  ZGQTensor  zsz  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsp  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsm  = ZGQTensor({pb_in, pb_out});
+  ZTenPtrVec zmps = ZTenPtrVec(N);
+
+  void SetUp(void) {
+    dsz({0, 0}) = 0.5;
+    dsz({1, 1}) = -0.5;
+    dsp({0, 1}) = 1;
+    dsm({1, 0}) = 1;
+
+    zsz({0, 0}) = 0.5;
+    zsz({1, 1}) = -0.5;
+    zsp({0, 1}) = 1;
+    zsm({1, 0}) = 1;
+  }
+};
+
+
+TEST_F(TestTdvpSpinSystem, 1DHeisenbergImagTime) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto tdvp_params = TdvpParams(
+                         0.5, 60,
+                         false, kTdvpTwoSite,
+                         1, 8, 1.0E-12,
+                         LanczosParams(1.0E-10, 30));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto e0 = TdvpAlgorithm(dmps, dmpo, tdvp_params);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-8);
+
+  // The one-site scheme keeps the bond dimensions, which are large enough
+  // for the exact ground state here.
+  tdvp_params.Scheme = kTdvpOneSite;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 8);
+  e0 = TdvpAlgorithm(dmps, dmpo, tdvp_params);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-8);
+}
+
+
+TEST_F(TestTdvpSpinSystem, 1DHeisenbergRealTime) {
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1,   {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+
+  // Start from the Neel state. The energy is conserved by the evolution.
+  std::vector<long> stat_labs;
+  for (long i = 0; i < N; ++i) { stat_labs.push_back(i % 2); }
+  DirectStateInitMps(zmps, stat_labs, pb_out, qn0);
+  auto tdvp_params = TdvpParams(
+                         0.05, 20,
+                         true, kTdvpTwoSite,
+                         1, 8, 1.0E-12,
+                         LanczosParams(1.0E-10, 30));
+  auto e = TdvpAlgorithm(zmps, zmpo, tdvp_params);
+  EXPECT_NEAR(e, -0.25*(N-1), 1.0E-8);
+
+  // The evolved state is not an eigenstate, so the one-site scheme goes on
+  // with a nontrivial state and must keep the energy too.
+  tdvp_params.Scheme = kTdvpOneSite;
+  e = TdvpAlgorithm(zmps, zmpo, tdvp_params);
+  EXPECT_NEAR(e, -0.25*(N-1), 1.0E-8);
+}
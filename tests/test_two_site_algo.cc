@@ -10,6 +10,10 @@
 #include "gqten/gqten.h"
 
 #include <vector>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
 
 
 using namespace gqmps2;
@@ -28,6 +32,31 @@ void RunTestTwoSiteAlgorithmCase(
 }
 
 
+// Total number of the Lanczos iterations of the run, summed over the updates
+// from its output.
+template <typename TenType>
+double RunTwoSiteAlgorithmCountingIters(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    long &lancz_iters) {
+  std::ostringstream out;
+  auto cout_buf = std::cout.rdbuf(out.rdbuf());
+  auto e0 = TwoSiteAlgorithm(mps, mpo, sweep_params);
+  std::cout.rdbuf(cout_buf);
+  lancz_iters = 0;
+  const std::string iters_key = "Iter =";
+  std::istringstream in(out.str());
+  std::string line;
+  while (std::getline(in, line)) {
+    auto pos = line.find(iters_key);
+    if (pos != std::string::npos) {
+      lancz_iters += std::stol(line.substr(pos + iters_key.size()));
+    }
+  }
+  return e0;
+}
+
+
 // Helpers
 inline void KeepOrder(long &x, long &y) {
   if (x > y) {
@@ -50,6 +79,47 @@ inline long coors2idxHoneycomb(
 }
 
 
+// Right canonical MPS of the normalized sum of two product states which
+// differ on every site.
+template <typename TenType>
+void TwoStatesSumInitMps(
+    std::vector<TenType *> &mps,
+    const std::vector<long> &stat_labs1, const std::vector<long> &stat_labs2,
+    const Index &pb_out, const QN &div) {
+  auto N = mps.size();
+  MpsFree(mps);
+  QN rvb_qn1 = div, rvb_qn2 = div;
+  Index lvb, rvb;
+  for (std::size_t i = 0; i < N; ++i) {
+    if (i > 0) { lvb = InverseIndex(rvb); }
+    if (i < N-1) {
+      rvb_qn1 = rvb_qn1 -
+                pb_out.CoorInterOffsetAndQnsct(stat_labs1[i]).qnsct.qn;
+      rvb_qn2 = rvb_qn2 -
+                pb_out.CoorInterOffsetAndQnsct(stat_labs2[i]).qnsct.qn;
+      if (rvb_qn1 == rvb_qn2) {
+        rvb = Index({QNSector(rvb_qn1, 2)}, OUT);
+      } else {
+        rvb = Index({QNSector(rvb_qn1, 1), QNSector(rvb_qn2, 1)}, OUT);
+      }
+    }
+    if (i == 0) {
+      mps[i] = new TenType({pb_out, rvb});
+      (*mps[i])({stat_labs1[i], 0}) = 1.0 / std::sqrt(2.0);
+      (*mps[i])({stat_labs2[i], 1}) = 1.0 / std::sqrt(2.0);
+    } else if (i == N-1) {
+      mps[i] = new TenType({lvb, pb_out});
+      (*mps[i])({0, stat_labs1[i]}) = 1;
+      (*mps[i])({1, stat_labs2[i]}) = 1;
+    } else {
+      mps[i] = new TenType({lvb, pb_out, rvb});
+      (*mps[i])({0, stat_labs1[i], 0}) = 1;
+      (*mps[i])({1, stat_labs2[i], 1}) = 1;
+    }
+  }
+}
+
+
 // Test spin systems
 struct TestTwoSiteAlgorithmSpinSystem : public testing::Test {
   long N = 6;
@@ -182,6 +252,1005 @@ TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenberg) {
   RunTestTwoSiteAlgorithmCase(
       zmps, zmpo, sweep_params,
       -2.493577133888, 1.0E-12);
+
+  // Lanczos with the single precision bases.
+  sweep_params.LanczParams.single_prec_bases = true;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+}
+
+
+// The blocks read ahead and dumped behind by the file I/O give the sweeps
+// without it, also across a continued run.
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergBlockIo) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     3,
+                     1, 4, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-10));
+  auto mem_sweep_params = sweep_params;
+  mem_sweep_params.FileIO = false;
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  DTenPtrVec dmem_mps(N);
+  for (long i = 0; i < N; ++i) { dmem_mps[i] = new DGQTensor(*dmps[i]); }
+  auto io_e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  auto mem_e0 = TwoSiteAlgorithm(dmem_mps, dmpo, mem_sweep_params);
+  EXPECT_NEAR(io_e0, mem_e0, 1.0E-10);
+  auto overlap = GenMpsOverlapTen(dmps, dmem_mps);
+  EXPECT_NEAR(std::abs(overlap->scalar), 1.0, 1.0E-10);
+  delete overlap;
+
+  // The continued run takes the blocks left on disk, while the run without
+  // the file I/O generates them again from the state.
+  sweep_params.Sweeps = 2;
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowContinue;
+  mem_sweep_params.Sweeps = 2;
+  io_e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  mem_e0 = TwoSiteAlgorithm(dmem_mps, dmpo, mem_sweep_params);
+  EXPECT_NEAR(io_e0, mem_e0, 1.0E-10);
+  overlap = GenMpsOverlapTen(dmps, dmem_mps);
+  EXPECT_NEAR(std::abs(overlap->scalar), 1.0, 1.0E-10);
+  delete overlap;
+  for (auto &mps_ten : dmem_mps) { delete mps_ten; }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergSchedule) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     20,
+                     1, 8, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  sweep_params.DmaxSchedule = {2, 4, 8};
+  sweep_params.CutoffSchedule = {1.0E-5, 1.0E-7, 1.0E-9};
+  sweep_params.LanczErrSchedule = {1.0E-5, 1.0E-7, 1.0E-9};
+  sweep_params.EnergyConvTol = 1.0E-12;
+  sweep_params.TruncErrConvTol = 1.0E-10;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  auto sweep_params_at = SweepParamsAt(sweep_params, 0);
+  EXPECT_EQ(sweep_params_at.Dmax, 2);
+  EXPECT_EQ(sweep_params_at.Dmin, 1);
+  EXPECT_DOUBLE_EQ(sweep_params_at.LanczParams.error, 1.0E-5);
+  sweep_params_at = SweepParamsAt(sweep_params, 10);
+  EXPECT_EQ(sweep_params_at.Dmax, 8);
+  EXPECT_DOUBLE_EQ(sweep_params_at.Cutoff, 1.0E-9);
+
+  // Adaptive Lanczos error, which takes fewer Lanczos iterations than the
+  // fixed error of its floor from the same initial state.
+  sweep_params.LanczErrSchedule.clear();
+  sweep_params.LanczParams.error = 1.0E-13;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  DTenPtrVec dinit_mps(N);
+  for (long i = 0; i < N; ++i) { dinit_mps[i] = new DGQTensor(*dmps[i]); }
+  long fixed_lancz_iters;
+  auto e0 = RunTwoSiteAlgorithmCountingIters(
+                dmps, dmpo, sweep_params,
+                fixed_lancz_iters);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-12);
+
+  sweep_params.LanczErrRatio = 1.0E-2;
+  sweep_params.LanczErrFloor = 1.0E-13;
+  long adaptive_lancz_iters;
+  e0 = RunTwoSiteAlgorithmCountingIters(
+           dinit_mps, dmpo, sweep_params,
+           adaptive_lancz_iters);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-12);
+  EXPECT_LT(adaptive_lancz_iters, fixed_lancz_iters);
+  for (auto &mps_ten : dinit_mps) { delete mps_ten; }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergUpdateCache) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     4,
+                     1, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  sweep_params.LanczErrSchedule = {1.0E-7, 1.0E-9};
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto blocks = InitBlocks(dmps, dmpo, false, false);
+  std::vector<DGQTensor *> eff_ham = {
+      blocks.first[0], dmpo[0], dmpo[1], blocks.second[N-2]};
+  auto init_state = Contract(*dmps[0], *dmps[1], {{1}, {0}});
+  auto lancz_params = SweepParamsAt(sweep_params, 1).LanczParams;
+  auto lancz_res = LanczosSolver(
+                       eff_ham, new DGQTensor(*init_state),
+                       lancz_params, "lend");
+
+  // The reused solution is the one of a fresh solve.
+  UpdateCache<DGQTensor> cache;
+  DTenPtrVec tgt_states;
+  std::vector<double> engs;
+  SaveUpdateCache(
+      cache, 0, lancz_params.error,
+      lancz_res.gs_eng, lancz_res.gs_vec, tgt_states, engs);
+  delete lancz_res.gs_vec;
+  auto cached_res = TakeUpdateCache(
+                        cache, 0, lancz_params.error,
+                        false, 0, tgt_states, engs);
+  ASSERT_NE(cached_res.gs_vec, nullptr);
+  EXPECT_EQ(cached_res.iters, 0);
+  EXPECT_EQ(cache.lsite, -1);
+  EXPECT_TRUE(cache.states.empty());
+  auto fresh_res = LanczosSolver(
+                       eff_ham, new DGQTensor(*init_state),
+                       lancz_params, "lend");
+  EXPECT_NEAR(cached_res.gs_eng, fresh_res.gs_eng, 1.0E-12);
+  auto overlap = Contract(
+                     Dag(*cached_res.gs_vec), *fresh_res.gs_vec,
+                     {{0, 1, 2}, {0, 1, 2}});
+  EXPECT_NEAR(std::abs(overlap->scalar), 1.0, 1.0E-10);
+  delete overlap;
+  delete cached_res.gs_vec;
+
+  // The cache is refused for other sites and for a tighter Lanczos error,
+  // from the schedule or the adaptive error, while a looser one takes it.
+  auto early_err = SweepParamsAt(sweep_params, 0).LanczParams.error;
+  SaveUpdateCache(
+      cache, 0, early_err,
+      fresh_res.gs_eng, fresh_res.gs_vec, tgt_states, engs);
+  cached_res = TakeUpdateCache(
+                   cache, 1, early_err, false, 0, tgt_states, engs);
+  EXPECT_EQ(cached_res.gs_vec, nullptr);
+  EXPECT_EQ(cache.lsite, -1);
+
+  SaveUpdateCache(
+      cache, 0, early_err,
+      fresh_res.gs_eng, fresh_res.gs_vec, tgt_states, engs);
+  cached_res = TakeUpdateCache(
+                   cache, 0, lancz_params.error, false, 0, tgt_states, engs);
+  EXPECT_EQ(cached_res.gs_vec, nullptr);
+  EXPECT_EQ(cache.lsite, -1);
+  EXPECT_TRUE(cache.states.empty());
+
+  sweep_params.LanczErrSchedule.clear();
+  sweep_params.LanczErrRatio = 1.0E-2;
+  sweep_params.LanczErrFloor = 1.0E-13;
+  auto adaptive_err = AdaptiveLanczErr(sweep_params, 1.0E-10, 1.0E-8);
+  EXPECT_LT(adaptive_err, early_err);
+  SaveUpdateCache(
+      cache, 0, early_err,
+      fresh_res.gs_eng, fresh_res.gs_vec, tgt_states, engs);
+  cached_res = TakeUpdateCache(
+                   cache, 0, adaptive_err, false, 0, tgt_states, engs);
+  EXPECT_EQ(cached_res.gs_vec, nullptr);
+
+  SaveUpdateCache(
+      cache, 0, lancz_params.error,
+      fresh_res.gs_eng, fresh_res.gs_vec, tgt_states, engs);
+  cached_res = TakeUpdateCache(
+                   cache, 0, early_err, false, 0, tgt_states, engs);
+  ASSERT_NE(cached_res.gs_vec, nullptr);
+  EXPECT_NEAR(cached_res.gs_eng, fresh_res.gs_eng, 1.0E-12);
+  delete cached_res.gs_vec;
+
+  FreeUpdateCache(cache);
+  delete fresh_res.gs_vec;
+  delete init_state;
+  for (auto &rblock : blocks.second) { delete rblock; }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergNoise) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     6,
+                     1, 8, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  sweep_params.NoiseSchedule = {1.0E-2, 1.0E-4, 0.0};
+  std::vector<long> stat_labs;
+  for (int i = 0; i < N; ++i) { stat_labs.push_back(i % 2); }
+  DirectStateInitMps(dmps, stat_labs, pb_out, qn0);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // The entanglement spectra are of the kept perturbed states, which differ
+  // from the converged state at the first order of the noise.
+  std::vector<double> conv_ees;
+  MeasuSession<GQTEN_Double> session(dmps);
+  for (long i = 0; i < N-1; ++i) {
+    conv_ees.push_back(
+        RenyiEntropy(GenBondEntSpec(session.BondSingularValues(i))));
+  }
+  auto noise_sweep_params = sweep_params;
+  noise_sweep_params.Sweeps = 2;
+  noise_sweep_params.NoiseSchedule.clear();
+  noise_sweep_params.Noise = 1.0E-3;
+  EntSpec ent_spec;
+  auto e0 = TwoSiteAlgorithm(dmps, dmpo, noise_sweep_params, &ent_spec);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-8);
+  for (long i = 0; i < N-1; ++i) {
+    EXPECT_NEAR(RenyiEntropy(ent_spec[i]), conv_ees[i], 1.0E-2);
+  }
+
+  // Complex Hamiltonian with state-averaged targets.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1,   {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  sweep_params.FileIO = false;
+  sweep_params.LanczParams.error = 1.0E-10;
+  RandomInitMps(zmps, pb_out, qn0, qn0, 2);
+  ZTenPtrVec ztgt_head_tens;
+  auto engs = TwoSiteMultiTargetAlgorithm(
+                  zmps, zmpo, sweep_params,
+                  2, ztgt_head_tens);
+  EXPECT_NEAR(engs[0], -2.493577133888, 1.0E-10);
+  EXPECT_NEAR(engs[1], -2.001995356898, 1.0E-10);
+  for (auto &head_ten : ztgt_head_tens) { delete head_ten; }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergDensMatTrunc) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     4,
+                     1, 8, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  sweep_params.DensMatTrunc = true;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // Truncated bonds agree with the full SVD.
+  sweep_params.Dmax = 3;
+  sweep_params.FileIO = false;
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto dm_energy = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  sweep_params.DensMatTrunc = false;
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto svd_energy = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  EXPECT_NEAR(dm_energy, svd_energy, 1.0E-8);
+
+  // The exchange with a phase is complex and gauge equivalent to the real one.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1, {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, 0.3), {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, -0.3), {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  sweep_params.Dmax = 8;
+  sweep_params.DensMatTrunc = true;
+  RandomInitMps(zmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+}
+
+
+template <typename TenElemType>
+void RunTestBlockSvdCase(
+    const GQTensor<TenElemType> &t, const QN &div,
+    const long Dmax) {
+  auto svd_res = Svd(t, 2, 2, div, div, 0.0, 1, Dmax);
+  auto block_svd_res = BlockSvd(t, 2, 2, div, div, 0.0, 1, Dmax, 4);
+  EXPECT_EQ(block_svd_res.D, svd_res.D);
+  EXPECT_NEAR(block_svd_res.trunc_err, svd_res.trunc_err, 1.0E-12);
+  EXPECT_NEAR(
+      MeasureEE(block_svd_res.s, block_svd_res.D),
+      MeasureEE(svd_res.s, svd_res.D),
+      1.0E-12);
+
+  auto us = Contract(*svd_res.u, *svd_res.s, {{2}, {0}});
+  auto usv = Contract(*us, *svd_res.v, {{2}, {0}});
+  auto block_us = Contract(*block_svd_res.u, *block_svd_res.s, {{2}, {0}});
+  auto block_usv = Contract(*block_us, *block_svd_res.v, {{2}, {0}});
+  LinearCombine({-1.0}, {usv}, block_usv);
+  EXPECT_NEAR(block_usv->Normalize(), 0.0, 1.0E-12);
+
+  for (auto res : {&svd_res, &block_svd_res}) {
+    delete res->u;
+    delete res->s;
+    delete res->v;
+  }
+  delete us;
+  delete usv;
+  delete block_us;
+  delete block_usv;
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergBlockSvd) {
+  // The quantum number blocks of a two-site tensor decomposed in parallel.
+  Index vb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", -1)}), 2),
+                     QNSector(QN({QNNameVal("Sz", 0)}), 3),
+                     QNSector(QN({QNNameVal("Sz", 1)}), 2)}, OUT);
+  Index vb_in = InverseIndex(vb_out);
+  srand(0);
+  DGQTensor dt({vb_in, pb_out, pb_out, vb_out});
+  dt.Random(qn0);
+  RunTestBlockSvdCase(dt, qn0, 100);
+  RunTestBlockSvdCase(dt, qn0, 5);
+  ZGQTensor zt({vb_in, pb_out, pb_out, vb_out});
+  zt.Random(qn0);
+  RunTestBlockSvdCase(zt, qn0, 100);
+  RunTestBlockSvdCase(zt, qn0, 5);
+
+  // Truncated bonds agree with the sequential SVD in the sweeps.
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+  auto sweep_params = SweepParams(
+                     4,
+                     1, 3, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto svd_energy = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  sweep_params.SvdThreadNum = 4;
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto block_svd_energy = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  EXPECT_NEAR(block_svd_energy, svd_energy, 1.0E-8);
+
+  // Complex MPS with the density matrix truncation solved in parallel.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1, {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, 0.3), {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(std::polar(0.5, -0.3), {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  sweep_params.Dmax = 8;
+  RandomInitMps(zmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+  sweep_params.DensMatTrunc = true;
+  RandomInitMps(zmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+}
+
+
+template <typename TenElemType>
+void RunTestBlockQrCase(
+    const GQTensor<TenElemType> &t, const QN &div,
+    const bool lq, const unsigned thread_num) {
+  using TenType = GQTensor<TenElemType>;
+  auto qr_res = BlockQr(t, 2, 2, div, lq, thread_num);
+  auto svd_res = Svd(t, 2, 2, Div(t) - div, div);
+
+  // The decomposition reconstructs t.
+  auto qr_t = Contract(*qr_res.first, *qr_res.second, {{2}, {0}});
+  auto diff = TenType(t);
+  LinearCombine({-1.0}, {qr_t}, &diff);
+  EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-12);
+
+  // The isometry has orthonormal columns, or rows for LQ, and spans the same
+  // space as the singular vectors.
+  TenType *iso_prod, *proj, *svd_proj;
+  if (!lq) {
+    auto q = qr_res.first;
+    iso_prod = Contract(Dag(*q), *q, {{0, 1}, {0, 1}});
+    proj = Contract(*q, Dag(*q), {{2}, {2}});
+    svd_proj = Contract(*svd_res.u, Dag(*svd_res.u), {{2}, {2}});
+    EXPECT_EQ(q->indexes[2].dim, svd_res.u->indexes[2].dim);
+  } else {
+    auto q = qr_res.second;
+    iso_prod = Contract(*q, Dag(*q), {{1, 2}, {1, 2}});
+    proj = Contract(Dag(*q), *q, {{0}, {0}});
+    svd_proj = Contract(Dag(*svd_res.v), *svd_res.v, {{0}, {0}});
+    EXPECT_EQ(q->indexes[0].dim, svd_res.v->indexes[0].dim);
+  }
+  long k = iso_prod->indexes[0].dim;
+  for (long i = 0; i < k; ++i) {
+    for (long j = 0; j < k; ++j) {
+      EXPECT_NEAR(
+          std::abs(iso_prod->Elem({i, j}) - (i == j ? 1.0 : 0.0)),
+          0.0, 1.0E-12);
+    }
+  }
+  LinearCombine({-1.0}, {svd_proj}, proj);
+  EXPECT_NEAR(proj->Normalize(), 0.0, 1.0E-12);
+
+  // The blocks are decomposed by QR, not by SVD, so r is upper and l lower
+  // triangular in each block.
+  auto zero_div = div - div;
+  auto tri = lq ? qr_res.first : qr_res.second;
+  auto tri_blks = lq ?
+                  GenTenMatBlocks(tri->indexes, 2, 1, Div(t) - div, zero_div) :
+                  GenTenMatBlocks(tri->indexes, 1, 2, zero_div, div);
+  auto tri_mats = GenDenseBlocks(*tri, tri_blks);
+  for (std::size_t b = 0; b < tri_mats.size(); ++b) {
+    long m = tri_blks.lcombos[b].dim;
+    long n = tri_blks.rcombos[b].dim;
+    for (long i = 0; i < m; ++i) {
+      for (long j = 0; j < n; ++j) {
+        if ((lq && j > i) || (!lq && j < i)) {
+          EXPECT_EQ(std::abs(tri_mats[b][i*n + j]), 0.0);
+        }
+      }
+    }
+  }
+
+  delete qr_res.first;
+  delete qr_res.second;
+  delete svd_res.u;
+  delete svd_res.s;
+  delete svd_res.v;
+  delete qr_t;
+  delete iso_prod;
+  delete proj;
+  delete svd_proj;
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, BlockQr) {
+  Index vb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", -1)}), 2),
+                     QNSector(QN({QNNameVal("Sz", 0)}), 3),
+                     QNSector(QN({QNNameVal("Sz", 1)}), 2)}, OUT);
+  Index vb_in = InverseIndex(vb_out);
+  srand(0);
+  DGQTensor dt({vb_in, pb_out, pb_out, vb_out});
+  dt.Random(qn0);
+  ZGQTensor zt({vb_in, pb_out, pb_out, vb_out});
+  zt.Random(qn0);
+  for (auto lq : {false, true}) {
+    for (unsigned thread_num : {1, 4}) {
+      RunTestBlockQrCase(dt, qn0, lq, thread_num);
+      RunTestBlockQrCase(zt, qn0, lq, thread_num);
+    }
+  }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergCompressMps) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     4,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // Without truncation the state is kept.
+  DTenPtrVec dcompressed_mps(N);
+  auto fidelity = CompressMps(
+                      dmps, dcompressed_mps,
+                      MpsCompressParams(1, 8, 0.0, kMpsCompressSvd, 0));
+  EXPECT_NEAR(fidelity, 1.0, 1.0E-10);
+  MpsFree(dcompressed_mps);
+
+  // The variational fittings improve the SVD compression.
+  auto svd_fidelity = CompressMps(
+                          dmps, dcompressed_mps,
+                          MpsCompressParams(1, 2, 0.0, kMpsCompressSvd, 0));
+  MpsFree(dcompressed_mps);
+  EXPECT_LT(svd_fidelity, 1.0 - 1.0E-4);
+  EXPECT_GT(svd_fidelity, 0.9);
+  auto one_site_fidelity = CompressMps(
+                               dmps, dcompressed_mps,
+                               MpsCompressParams(
+                                   1, 2, 0.0, kMpsCompressOneSite, 4));
+  MpsFree(dcompressed_mps);
+  EXPECT_GT(one_site_fidelity, svd_fidelity - 1.0E-10);
+  auto two_site_fidelity = CompressMps(
+                               dmps, dcompressed_mps,
+                               MpsCompressParams(
+                                   1, 2, 0.0, kMpsCompressTwoSite, 4));
+  MpsFree(dcompressed_mps);
+  EXPECT_GT(two_site_fidelity, svd_fidelity - 1.0E-10);
+
+  // The Hamiltonian applied to the ground state is fitted to it.
+  for (auto method : {kMpsCompressSvd, kMpsCompressOneSite,
+                      kMpsCompressTwoSite}) {
+    auto mpo_fidelity = CompressMps(
+                            dmpo, dmps, dcompressed_mps,
+                            MpsCompressParams(1, 8, 0.0, method, 2));
+    EXPECT_NEAR(mpo_fidelity, 1.0, 1.0E-10);
+    auto overlap = GenMpsOverlapTen(dcompressed_mps, dmps);
+    EXPECT_NEAR(std::abs(overlap->scalar), 1.0, 1.0E-10);
+    delete overlap;
+    MpsFree(dcompressed_mps);
+  }
+
+  // The fidelity of the truncated product agrees with the overlap with the
+  // untruncated one, and the variational fittings improve it.
+  srand(0);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  DTenPtrVec dexact_mps(N);
+  auto exact_fidelity = CompressMps(
+                            dmpo, dmps, dexact_mps,
+                            MpsCompressParams(1, 64, 0.0, kMpsCompressSvd, 0));
+  EXPECT_NEAR(exact_fidelity, 1.0, 1.0E-10);
+  std::vector<double> mpo_fidelities;
+  for (auto method : {kMpsCompressSvd, kMpsCompressOneSite,
+                      kMpsCompressTwoSite}) {
+    auto mpo_fidelity = CompressMps(
+                            dmpo, dmps, dcompressed_mps,
+                            MpsCompressParams(1, 2, 0.0, method, 4));
+    auto overlap = GenMpsOverlapTen(dcompressed_mps, dexact_mps);
+    EXPECT_NEAR(std::abs(overlap->scalar), mpo_fidelity, 1.0E-10);
+    delete overlap;
+    MpsFree(dcompressed_mps);
+    mpo_fidelities.push_back(mpo_fidelity);
+  }
+  EXPECT_LT(mpo_fidelities[0], 1.0 - 1.0E-4);
+  EXPECT_GT(mpo_fidelities[1], mpo_fidelities[0] - 1.0E-10);
+  EXPECT_GT(mpo_fidelities[2], mpo_fidelities[0] - 1.0E-10);
+  MpsFree(dexact_mps);
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergEnlargeMps) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     4,
+                     2, 2, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  auto e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  EXPECT_GT(e0, -2.493577133888 + 1.0E-4);
+
+  // Without noise the state is kept on the enlarged bonds.
+  DTenPtrVec dsmall_mps(N);
+  for (long i = 0; i < N; ++i) { dsmall_mps[i] = new DGQTensor(*dmps[i]); }
+  EnlargeMps(dmps, 8);
+  EXPECT_EQ(dmps[N/2-1]->indexes.back().dim, 8);
+  EXPECT_EQ(dmps[0]->indexes.back().dim, 2);
+  auto overlap = GenMpsOverlapTen(dsmall_mps, dmps);
+  EXPECT_NEAR(std::abs(overlap->scalar), 1.0, 1.0E-10);
+  delete overlap;
+
+  sweep_params = SweepParams(
+                     2,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // Random padding.
+  MpsFree(dmps);
+  for (long i = 0; i < N; ++i) { dmps[i] = new DGQTensor(*dsmall_mps[i]); }
+  EnlargeMps(dmps, 8, 0.1);
+  EXPECT_EQ(dmps[N/2-1]->indexes.back().dim, 8);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+  MpsFree(dsmall_mps);
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergInfiniteWarmUp) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+  std::vector<long> stat_labs;
+  for (long i = 0; i < N; ++i) { stat_labs.push_back(i % 2); }
+
+  // The last step is exact without truncation and the sweeps continue from
+  // the dumped blocks.
+  auto sweep_params = SweepParams(
+                     2,
+                     8, 8, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowContinue,
+                     LanczosParams(1.0E-9));
+  auto e0 = InfiniteWarmUp(dmps, dmpo, sweep_params, stat_labs, pb_out);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-10);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // Truncated warm-up.
+  sweep_params = SweepParams(
+                     2,
+                     2, 2, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  e0 = InfiniteWarmUp(dmps, dmpo, sweep_params, stat_labs, pb_out);
+  EXPECT_GT(e0, -2.493577133888);
+  EXPECT_LT(e0, -2.2);
+  sweep_params = SweepParams(
+                     2,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergParallel) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     8,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  for (long seg_num = 1; seg_num <= N/2; ++seg_num) {
+    RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+    auto e0 = ParallelTwoSiteAlgorithm(dmps, dmpo, sweep_params, seg_num);
+    EXPECT_NEAR(e0, -2.493577133888, 1.0E-8);
+
+    // The glued MPS is the ground state.
+    auto eng_ten = GenMpsMpoOverlapTen(dmps, dmpo, dmps);
+    auto norm_ten = GenMpsOverlapTen(dmps, dmps);
+    EXPECT_NEAR(eng_ten->scalar / norm_ten->scalar, -2.493577133888, 1.0E-8);
+    delete eng_ten;
+    delete norm_ten;
+  }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergEntSpec) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     4,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  EntSpec ent_spec;
+  auto e0 = TwoSiteAlgorithm(dmps, dmpo, sweep_params, &ent_spec);
+  EXPECT_NEAR(e0, -2.493577133888, 1.0E-12);
+  EXPECT_EQ(ent_spec.size(), dmps.size()-1);
+
+  MeasuSession<GQTEN_Double> session(dmps);
+  for (long i = 0; i < N-1; ++i) {
+    auto &bond_ent_spec = ent_spec[i];
+    EXPECT_EQ(bond_ent_spec.qns.size(), bond_ent_spec.svals.size());
+    double norm = 0;
+    for (auto &svals : bond_ent_spec.svals) {
+      for (auto sval : svals) { norm += sval * sval; }
+    }
+    EXPECT_NEAR(norm, 1.0, 1.0E-12);
+
+    auto bond_ent_spec_from_mps = GenBondEntSpec(session.BondSingularValues(i));
+    EXPECT_NEAR(
+        RenyiEntropy(bond_ent_spec),
+        RenyiEntropy(bond_ent_spec_from_mps), 1.0E-8);
+    EXPECT_NEAR(
+        RenyiEntropy(bond_ent_spec, 2),
+        RenyiEntropy(bond_ent_spec_from_mps, 2), 1.0E-8);
+    EXPECT_GE(
+        RenyiEntropy(bond_ent_spec) + 1.0E-12, RenyiEntropy(bond_ent_spec, 2));
+  }
+
+  DumpEntSpec(ent_spec, "ent_spec");
+  DumpEntSpec(ent_spec, "ent_spec", kEntSpecFormatMsgPack);
+  std::ifstream ifs("ent_spec.json");
+  json bonds;
+  ifs >> bonds;
+  EXPECT_EQ(bonds.size(), dmps.size()-1);
+  std::ifstream bin_ifs("ent_spec.msgpack", std::ios::binary);
+  std::vector<uint8_t> bin_data(
+      (std::istreambuf_iterator<char>(bin_ifs)),
+      std::istreambuf_iterator<char>());
+  EXPECT_EQ(json::from_msgpack(bin_data), bonds);
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergExcitedState) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  auto sweep_params = SweepParams(
+                     6,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-9));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // The lowest excitation is the Sz = 0 member of the lowest triplet.
+  auto qn1 = QN({QNNameVal("Sz", 2)});
+  DTenPtrVec dtriplet_mps(N);
+  RandomInitMps(dtriplet_mps, pb_out, qn1, qn0, 4);
+  auto triplet_e0 = TwoSiteAlgorithm(dtriplet_mps, dmpo, sweep_params);
+
+  DTenPtrVec dexcited_mps(N);
+  RandomInitMps(dexcited_mps, pb_out, qn0, qn0, 4);
+  auto e1 = TwoSiteAlgorithm(
+                dexcited_mps, dmpo, sweep_params,
+                {dmps}, 10.0);
+  EXPECT_NEAR(e1, triplet_e0, 1.0E-8);
+
+  // With file I/O.
+  sweep_params.FileIO = true;
+  RandomInitMps(dexcited_mps, pb_out, qn0, qn0, 4);
+  e1 = TwoSiteAlgorithm(
+           dexcited_mps, dmpo, sweep_params,
+           {dmps}, 10.0);
+  EXPECT_NEAR(e1, triplet_e0, 1.0E-8);
+
+  for (auto &mps_ten : dtriplet_mps) { delete mps_ten; }
+  for (auto &mps_ten : dexcited_mps) { delete mps_ten; }
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenbergRealMpo) {
+  auto sweep_params = SweepParams(
+                     4,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+
+  // A complex MPO with real elements is swept in real.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1,   {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  for (long i = 0; i < N; ++i) {
+    delete zmps[i];
+    zmps[i] = GenPromotedTen<ZGQTensor>(*dmps[i]);
+  }
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+  for (auto &mps_ten : zmps) {
+    auto real_ten = GenRealTen(*mps_ten, false);
+    EXPECT_NE(real_ten, nullptr);
+    delete real_ten;
+  }
+
+  // With file I/O, the real sweeps leave the blocks on disk, from which the
+  // sweeps continue in complex.
+  auto fileio_sweep_params = sweep_params;
+  fileio_sweep_params.FileIO = true;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  for (long i = 0; i < N; ++i) {
+    delete zmps[i];
+    zmps[i] = GenPromotedTen<ZGQTensor>(*dmps[i]);
+  }
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, fileio_sweep_params,
+      -2.493577133888, 1.0E-12);
+  fileio_sweep_params.Workflow = kTwoSiteAlgoWorkflowContinue;
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zmpo, fileio_sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // A complex state is swept in complex, so it is not changed by no sweep.
+  RandomInitMps(zmps, pb_out, qn0, qn0, 4);
+  std::vector<ZGQTensor> zinit_tens;
+  for (auto &mps_ten : zmps) { zinit_tens.push_back(*mps_ten); }
+  auto no_sweep_params = sweep_params;
+  no_sweep_params.Sweeps = 0;
+  TwoSiteAlgorithm(zmps, zmpo, no_sweep_params);
+  for (long i = 0; i < N; ++i) { EXPECT_TRUE(*zmps[i] == zinit_tens[i]); }
+
+  // The twisted exchange 0.5 * (1 + i d) S+S- + h.c. is complex. It is gauge
+  // equivalent to the exchange sqrt(1 + d^2).
+  double d = 0.5;
+  auto zdm_mpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  auto dxxz_mpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zdm_mpo_gen.AddTerm(1, {zsz, zsz}, {i, i+1});
+    zdm_mpo_gen.AddTerm(GQTEN_Complex(0.5, 0.5*d), {zsp, zsm}, {i, i+1});
+    zdm_mpo_gen.AddTerm(GQTEN_Complex(0.5, -0.5*d), {zsm, zsp}, {i, i+1});
+    dxxz_mpo_gen.AddTerm(1, {dsz, dsz}, {i, i+1});
+    dxxz_mpo_gen.AddTerm(0.5*std::sqrt(1+d*d), {dsp, dsm}, {i, i+1});
+    dxxz_mpo_gen.AddTerm(0.5*std::sqrt(1+d*d), {dsm, dsp}, {i, i+1});
+  }
+  auto zdm_mpo = zdm_mpo_gen.Gen();
+  auto dxxz_mpo = dxxz_mpo_gen.Gen();
+  bool is_real_mpo = true;
+  for (auto &mpo_ten : zdm_mpo) {
+    auto real_ten = GenRealTen(*mpo_ten, false);
+    if (real_ten == nullptr) { is_real_mpo = false; }
+    delete real_ten;
+  }
+  EXPECT_FALSE(is_real_mpo);
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  auto dxxz_e0 = TwoSiteAlgorithm(dmps, dxxz_mpo, sweep_params);
+  RandomInitMps(zmps, pb_out, qn0, qn0, 4);
+  RunTestTwoSiteAlgorithmCase(
+      zmps, zdm_mpo, sweep_params,
+      dxxz_e0, 1.0E-10);
+}
+
+
+TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DMultiTarget) {
+  auto sweep_params = SweepParams(
+                     6,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-10));
+
+  // Two decoupled three-site Heisenberg chains, whose Sz = 0 ground states are
+  // doubly degenerate.
+  auto dpair_mpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    if (i == 2) { continue; }
+    dpair_mpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dpair_mpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dpair_mpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dpair_mpo = dpair_mpo_gen.Gen();
+  // The Sz of each chain is conserved, and the targets can get stuck in the
+  // ground state and an excited state of a single sector of it. The state and
+  // the target start from the sum and the difference of the two Neel states,
+  // which are of both sectors.
+  std::vector<long> neel_labs1 = {0, 1, 0, 1, 0, 1};
+  std::vector<long> neel_labs2 = {1, 0, 1, 0, 1, 0};
+  TwoStatesSumInitMps(dmps, neel_labs1, neel_labs2, pb_out, qn0);
+  DTenPtrVec dtgt_head_tens = {new DGQTensor(*dmps[0])};
+  (*dtgt_head_tens[0])({neel_labs2[0], 1}) = -1.0 / std::sqrt(2.0);
+  auto engs = TwoSiteMultiTargetAlgorithm(
+                  dmps, dpair_mpo, sweep_params,
+                  2, dtgt_head_tens);
+  EXPECT_EQ(engs.size(), 2);
+  EXPECT_EQ(dtgt_head_tens.size(), 1);
+  EXPECT_NEAR(engs[0], -2.0, 1.0E-10);
+  EXPECT_NEAR(engs[1], -2.0, 1.0E-10);
+  auto overlap = Contract(
+                     *dmps[0], Dag(*dtgt_head_tens[0]),
+                     {{0, 1}, {0, 1}});
+  EXPECT_NEAR(overlap->scalar, 0.0, 1.0E-10);
+  delete overlap;
+  for (auto &head_ten : dtgt_head_tens) { delete head_ten; }
+
+  // Singlet ground state and the lowest triplet.
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+  auto qn1 = QN({QNNameVal("Sz", 2)});
+  DTenPtrVec dtriplet_mps(N);
+  RandomInitMps(dtriplet_mps, pb_out, qn1, qn0, 4);
+  auto triplet_e0 = TwoSiteAlgorithm(dtriplet_mps, dmpo, sweep_params);
+  for (auto &mps_ten : dtriplet_mps) { delete mps_ten; }
+
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  dtgt_head_tens.clear();
+  engs = TwoSiteMultiTargetAlgorithm(
+             dmps, dmpo, sweep_params,
+             2, dtgt_head_tens);
+  EXPECT_NEAR(engs[0], -2.493577133888, 1.0E-10);
+  EXPECT_NEAR(engs[1], triplet_e0, 1.0E-10);
+  for (auto &head_ten : dtgt_head_tens) { delete head_ten; }
+
+  // Complex Hamiltonian with file I/O.
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1,   {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+  sweep_params.FileIO = true;
+  RandomInitMps(zmps, pb_out, qn0, qn0, 4);
+  ZTenPtrVec ztgt_head_tens;
+  engs = TwoSiteMultiTargetAlgorithm(
+             zmps, zmpo, sweep_params,
+             2, ztgt_head_tens);
+  EXPECT_NEAR(engs[0], -2.493577133888, 1.0E-10);
+  EXPECT_NEAR(engs[1], triplet_e0, 1.0E-10);
+  for (auto &head_ten : ztgt_head_tens) { delete head_ten; }
 }
 
 